@@ -55,6 +55,9 @@
   INLINE void    HAL_GPIO_##name##_pullup(void)   { PORT##port.PIN##bit##CTRL = PORT_OPC_PULLUP_gc; } \
   INLINE void    HAL_GPIO_##name##_pulldown(void) { PORT##port.PIN##bit##CTRL = PORT_OPC_PULLDOWN_gc; } \
   INLINE uint8_t HAL_GPIO_##name##_read(void)     { return (PORT##port.IN & (1 << bit)) != 0; } \
-  INLINE uint8_t HAL_GPIO_##name##_state(void)    { return (PORT##port.DIR & (1 << bit)) != 0; }
+  INLINE uint8_t HAL_GPIO_##name##_state(void)    { return (PORT##port.DIR & (1 << bit)) != 0; } \
+  INLINE void    HAL_GPIO_##name##_irq(void)      { PORT##port.PIN##bit##CTRL = PORT_ISC_RISING_gc; \
+                                                    PORT##port.INT0MASK |= (1 << bit); \
+                                                    PORT##port.INTCTRL |= PORT_INT0LVL_LO_gc; }
 
 #endif // _HAL_GPIO_H_
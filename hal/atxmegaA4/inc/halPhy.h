@@ -57,6 +57,7 @@
 #if defined(PLATFORM_MR16_BOARD)
   HAL_GPIO_PIN(PHY_RST,    D, 1);
   HAL_GPIO_PIN(PHY_IRQ,    C, 3);
+  #define HAL_PHY_IRQ_vect     PORTC_INT0_vect
   HAL_GPIO_PIN(PHY_SLP_TR, D, 0);
   HAL_GPIO_PIN(PHY_CS,     C, 4);
   HAL_GPIO_PIN(PHY_MOSI,   C, 5);
@@ -65,6 +66,7 @@
 #elif defined(PLATFORM_TIDMARSH_NODE)
   HAL_GPIO_PIN(PHY_RST,    C, 2);
   HAL_GPIO_PIN(PHY_IRQ,    D, 0);
+  #define HAL_PHY_IRQ_vect     PORTD_INT0_vect
   HAL_GPIO_PIN(PHY_SLP_TR, C, 3);
   HAL_GPIO_PIN(PHY_CS,     C, 4);
   HAL_GPIO_PIN(PHY_MOSI,   C, 5);
@@ -73,6 +75,7 @@
 #elif defined(PLATFORM_TIDMARSH_MK2)
   HAL_GPIO_PIN(PHY_RST,    D, 1);
   HAL_GPIO_PIN(PHY_IRQ,    C, 3);
+  #define HAL_PHY_IRQ_vect     PORTC_INT0_vect
   HAL_GPIO_PIN(PHY_SLP_TR, D, 0);
   HAL_GPIO_PIN(PHY_CS,     C, 4);
   HAL_GPIO_PIN(PHY_MOSI,   C, 5);
@@ -81,6 +84,7 @@
 #elif defined(PLATFORM_BASESTATION)
   HAL_GPIO_PIN(PHY_RST,    D, 1);
   HAL_GPIO_PIN(PHY_IRQ,    C, 3);
+  #define HAL_PHY_IRQ_vect     PORTC_INT0_vect
   HAL_GPIO_PIN(PHY_SLP_TR, D, 0);
   HAL_GPIO_PIN(PHY_CS,     C, 4);
   HAL_GPIO_PIN(PHY_MOSI,   C, 5);
@@ -98,6 +102,10 @@ uint8_t HAL_PhySpiWriteByte(uint8_t value);
 void HAL_PhyReset(void);
 void halPhyInit(void);
 
+#ifdef PHY_ENABLE_IRQ
+bool HAL_PhyIrqPending(void);
+#endif
+
 #ifdef PHY_ENABLE_FRONTEND
 void HAL_PhyFrontendSetShutdown(bool shutdown);
 void HAL_PhyFrontendEnableLNA(bool enabled);
@@ -48,6 +48,33 @@
 #include "hal.h"
 #include "phy.h"
 
+#ifdef PHY_ENABLE_IRQ
+/*****************************************************************************
+*****************************************************************************/
+static volatile bool halPhyIrq;
+
+/*****************************************************************************
+*****************************************************************************/
+ISR(HAL_PHY_IRQ_vect)
+{
+  halPhyIrq = true;
+}
+
+/*****************************************************************************
+  Returns true once for every rising edge of the transceiver IRQ line. The
+  flag is cleared before the caller reads IRQ_STATUS, so an edge that
+  arrives in between is either reported now or on the next call.
+*****************************************************************************/
+bool HAL_PhyIrqPending(void)
+{
+  if (!halPhyIrq)
+    return false;
+
+  halPhyIrq = false;
+  return true;
+}
+#endif
+
 /*****************************************************************************
 *****************************************************************************/
 uint8_t HAL_PhySpiWriteByte(uint8_t value)
@@ -91,6 +118,10 @@ void halPhyInit(void)
   HAL_GPIO_PHY_SLP_TR_out();
   HAL_GPIO_PHY_RST_out();
   HAL_GPIO_PHY_IRQ_in();
+#ifdef PHY_ENABLE_IRQ
+  halPhyIrq = false;
+  HAL_GPIO_PHY_IRQ_irq();
+#endif
   HAL_GPIO_PHY_CS_out();
   HAL_GPIO_PHY_MISO_in();
   HAL_GPIO_PHY_MOSI_out();
@@ -50,19 +50,24 @@
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
 #include <stdbool.h>
+#include "phy.h"
 #include "sysConfig.h"
+#include "sysEncrypt.h"
 #include "nwkRoute.h"
 #include "nwkGroup.h"
 #include "nwkSecurity.h"
 #include "nwkDataReq.h"
+#include "nwkCollection.h"
+#include "nwkSourceRoute.h"
 
 /*- Definitions ------------------------------------------------------------*/
-#define NWK_MAX_PAYLOAD_SIZE            (127 - 16/*NwkFrameHeader_t*/ - 2/*crc*/)
+#define NWK_MAX_PAYLOAD_SIZE            (127 - 16/*NwkFrameHeader_t*/ - 2/*crc*/) // without optional headers
 
 #define NWK_BROADCAST_PANID             0xffff
 #define NWK_BROADCAST_ADDR              0xffff
 
 #define NWK_ENDPOINTS_AMOUNT            16
+#define NWK_SERVICE_ENDPOINT_ID         0
 
 /*- Types ------------------------------------------------------------------*/
 typedef enum
@@ -84,9 +89,17 @@ typedef struct NwkIb_t
   uint16_t     panId;
   uint8_t      nwkSeqNum;
   uint8_t      macSeqNum;
+  uint8_t      dataRate;
   bool         (*endpoint[NWK_ENDPOINTS_AMOUNT])(NWK_DataInd_t *ind);
 #ifdef NWK_ENABLE_SECURITY
-  uint32_t     key[4];
+  uint32_t     key[SYS_ENCRYPT_KEY_SIZE / 4];
+  uint16_t     securityRejects;
+#endif
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  uint32_t     frameCounter;
+#endif
+#ifdef NWK_ENABLE_HOP_LIMIT
+  uint16_t     hopLimitDrops;
 #endif
   uint16_t     lock;
 } NwkIb_t;
@@ -98,6 +111,9 @@ extern NwkIb_t nwkIb;
 void NWK_Init(void);
 void NWK_SetAddr(uint16_t addr);
 void NWK_SetPanId(uint16_t panId);
+#ifdef PHY_HAS_HIGH_DATA_RATES
+void NWK_SetDataRate(uint8_t rate);
+#endif
 void NWK_OpenEndpoint(uint8_t id, bool (*handler)(NWK_DataInd_t *ind));
 bool NWK_Busy(void);
 void NWK_Lock(void);
@@ -0,0 +1,74 @@
+/**
+ * \file nwkCollection.h
+ *
+ * \brief Collection tree routing interface
+ *
+ * Copyright (C) 2012-2014, Atmel Corporation. All rights reserved.
+ *
+ * \asf_license_start
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. The name of Atmel may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. This software may only be redistributed and used in connection with an
+ *    Atmel microcontroller product.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * EXPRESSLY AND SPECIFICALLY DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \asf_license_stop
+ *
+ * Modification and other use of this code is subject to Atmel's Limited
+ * License Agreement (license.txt).
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _NWK_COLLECTION_H_
+#define _NWK_COLLECTION_H_
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "sysTypes.h"
+#include "nwkRx.h"
+#include "nwkFrame.h"
+
+#ifdef NWK_ENABLE_COLLECTION
+
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_COLLECTION_NO_ROUTE      0xffff
+
+/*- Prototypes -------------------------------------------------------------*/
+void NWK_CollectionSetSink(bool sink);
+uint16_t NWK_CollectionSinkAddr(void);
+uint16_t NWK_CollectionParentAddr(void);
+uint16_t NWK_CollectionCost(void);
+
+void nwkCollectionInit(void);
+bool nwkCollectionAdvertisementReceived(NWK_DataInd_t *ind);
+void nwkCollectionFrameSent(NwkFrame_t *frame);
+
+#endif // NWK_ENABLE_COLLECTION
+
+#endif // _NWK_COLLECTION_H_
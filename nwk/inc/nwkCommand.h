@@ -58,6 +58,9 @@ enum
   NWK_COMMAND_ROUTE_ERROR         = 0x01,
   NWK_COMMAND_ROUTE_REQUEST       = 0x02,
   NWK_COMMAND_ROUTE_REPLY         = 0x03,
+  NWK_COMMAND_COLLECTION_ADVERTISEMENT = 0x04,
+  NWK_COMMAND_GROUP_ADD           = 0x05,
+  NWK_COMMAND_GROUP_REMOVE        = 0x06,
 };
 
 typedef struct PACK NwkCommandAck_t
@@ -67,12 +70,17 @@ typedef struct PACK NwkCommandAck_t
   uint8_t    control;
 } NwkCommandAck_t;
 
+typedef struct PACK NwkCommandRouteErrorDst_t
+{
+  uint16_t   dstAddr;
+  uint8_t    multicast;
+} NwkCommandRouteErrorDst_t;
+
 typedef struct PACK NwkCommandRouteError_t
 {
   uint8_t    id;
   uint16_t   srcAddr;
-  uint16_t   dstAddr;
-  uint8_t    multicast;
+  NwkCommandRouteErrorDst_t dst[];
 } NwkCommandRouteError_t;
 
 typedef struct PACK NwkCommandRouteRequest_t
@@ -82,6 +90,7 @@ typedef struct PACK NwkCommandRouteRequest_t
   uint16_t   dstAddr;
   uint8_t    multicast;
   uint8_t    linkQuality;
+  uint8_t    radius;
 } NwkCommandRouteRequest_t;
 
 typedef struct PACK NwkCommandRouteReply_t
@@ -94,4 +103,17 @@ typedef struct PACK NwkCommandRouteReply_t
   uint8_t    reverseLinkQuality;
 } NwkCommandRouteReply_t;
 
+typedef struct PACK NwkCommandCollectionAdvertisement_t
+{
+  uint8_t    id;
+  uint16_t   sinkAddr;
+  uint16_t   cost;
+} NwkCommandCollectionAdvertisement_t;
+
+typedef struct PACK NwkCommandGroup_t
+{
+  uint8_t    id;
+  uint16_t   group[];
+} NwkCommandGroup_t;
+
 #endif // _NWK_COMMAND_H_
@@ -49,6 +49,7 @@
 
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
+#include <stdbool.h>
 #include "sysTypes.h"
 
 /*- Definitions ------------------------------------------------------------*/
@@ -69,7 +70,10 @@ typedef struct PACK NwkFrameHeader_t
     uint8_t   security   : 1;
     uint8_t   linkLocal  : 1;
     uint8_t   multicast  : 1;
-    uint8_t   reserved   : 4;
+    uint8_t   sourceRoute : 1;
+    uint8_t   hopLimit   : 1;
+    uint8_t   keyIndex   : 1;
+    uint8_t   frameCounter : 1;
   }           nwkFcf;
   uint8_t     nwkSeq;
   uint16_t    nwkSrcAddr;
@@ -89,6 +93,14 @@ typedef struct PACK NwkFrameMulticastHeader_t
   uint16_t    maxMemberRadius    : 4;
 } NwkFrameMulticastHeader_t;
 
+typedef struct PACK NwkFrameSourceRouteHeader_t
+{
+  uint8_t     count  : 4;
+  uint8_t     index  : 3;
+  uint8_t     record : 1;
+  uint16_t    hops[];
+} NwkFrameSourceRouteHeader_t;
+
 typedef struct NwkFrame_t
 {
   uint8_t      state;
@@ -115,6 +127,9 @@ typedef struct NwkFrame_t
       uint8_t  status;
       uint16_t timeout;
       uint8_t  control;
+    #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+      uint8_t  heard;
+    #endif
       void     (*confirm)(struct NwkFrame_t *frame);
     } tx;
   };
@@ -126,6 +141,8 @@ NwkFrame_t *nwkFrameAlloc(void);
 void nwkFrameFree(NwkFrame_t *frame);
 NwkFrame_t *nwkFrameNext(NwkFrame_t *frame);
 void nwkFrameCommandInit(NwkFrame_t *frame);
+void nwkFrameHopLimitInit(NwkFrame_t *frame);
+bool nwkFrameDecrementHopLimit(NwkFrame_t *frame);
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -136,4 +153,33 @@ static inline uint8_t nwkFramePayloadSize(NwkFrame_t *frame)
   return frame->size - (frame->payload - frame->data);
 }
 
+/*************************************************************************//**
+*****************************************************************************/
+static inline uint8_t *nwkFrameHopLimit(NwkFrame_t *frame)
+{
+  return frame->data + sizeof(NwkFrameHeader_t);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static inline uint8_t *nwkFrameKeyIndex(NwkFrame_t *frame)
+{
+  return nwkFrameHopLimit(frame) + frame->header.nwkFcf.hopLimit;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static inline uint8_t *nwkFrameFrameCounter(NwkFrame_t *frame)
+{
+  return nwkFrameKeyIndex(frame) + frame->header.nwkFcf.keyIndex;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static inline NwkFrameSourceRouteHeader_t *nwkFrameSourceRouteHeader(NwkFrame_t *frame)
+{
+  return (NwkFrameSourceRouteHeader_t *)(nwkFrameFrameCounter(frame) +
+      frame->header.nwkFcf.frameCounter * sizeof(uint32_t));
+}
+
 #endif // _NWK_FRAME_H_
@@ -49,20 +49,56 @@
 
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
+#include <stdbool.h>
 #include "sysTypes.h"
+#include "nwkRx.h"
 
 #ifdef NWK_ENABLE_MULTICAST
 
 /*- Definitions ------------------------------------------------------------*/
 #define NWK_MULTICAST_HEADER_SIZE    2
 
+#ifdef NWK_ENABLE_HOP_LIMIT
+  #define NWK_GROUP_COMMAND_HOP_LIMIT_SIZE     1
+#else
+  #define NWK_GROUP_COMMAND_HOP_LIMIT_SIZE     0
+#endif
+
+#ifdef NWK_ENABLE_KEY_TABLE
+  #define NWK_GROUP_COMMAND_KEY_INDEX_SIZE     1
+#else
+  #define NWK_GROUP_COMMAND_KEY_INDEX_SIZE     0
+#endif
+
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  #define NWK_GROUP_COMMAND_FRAME_COUNTER_SIZE 4
+#else
+  #define NWK_GROUP_COMMAND_FRAME_COUNTER_SIZE 0
+#endif
+
+// Fits into a secured multicast frame with all enabled optional headers
+#define NWK_GROUP_COMMAND_MAX_GROUPS ((NWK_MAX_PAYLOAD_SIZE - 1/*id*/ - \
+    NWK_MULTICAST_HEADER_SIZE - 4/*mic*/ - NWK_GROUP_COMMAND_HOP_LIMIT_SIZE - \
+    NWK_GROUP_COMMAND_KEY_INDEX_SIZE - NWK_GROUP_COMMAND_FRAME_COUNTER_SIZE) / 2)
+
 /*- Prototypes -------------------------------------------------------------*/
 bool NWK_GroupIsMember(uint16_t group);
 bool NWK_GroupAdd(uint16_t group);
 bool NWK_GroupRemove(uint16_t group);
+uint8_t NWK_GroupAddList(uint16_t *groups, uint8_t count);
+uint8_t NWK_GroupRemoveList(uint16_t *groups, uint8_t count);
+
+#ifdef NWK_ENABLE_GROUP_COMMANDS
+uint8_t NWK_GroupAddCommand(uint8_t *data, uint16_t *groups, uint8_t count);
+uint8_t NWK_GroupRemoveCommand(uint8_t *data, uint16_t *groups, uint8_t count);
+#endif
 
 void nwkGroupInit(void);
 
+#ifdef NWK_ENABLE_GROUP_COMMANDS
+bool nwkGroupCommandReceived(NWK_DataInd_t *ind);
+#endif
+
 #endif // NWK_ENABLE_MULTICAST
 
 #endif // _NWK_FRAME_H_
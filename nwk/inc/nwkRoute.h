@@ -64,12 +64,14 @@ typedef struct NWK_RouteTableEntry_t
 {
   uint8_t  fixed     : 1;
   uint8_t  multicast : 1;
-  uint8_t  reserved  : 2;
+  uint8_t  collection: 1;
+  uint8_t  reserved  : 1;
   uint8_t  score     : 4;
   uint16_t dstAddr;
   uint16_t nextHopAddr;
-  uint8_t  rank;
   uint8_t  lqi;
+  uint8_t  prev;
+  uint8_t  next;
 } NWK_RouteTableEntry_t;
 
 /*- Prototypes -------------------------------------------------------------*/
@@ -82,6 +84,7 @@ NWK_RouteTableEntry_t *NWK_RouteTable(void);
 void nwkRouteInit(void);
 void nwkRouteRemove(uint16_t dst, uint8_t multicast);
 void nwkRouteFrameReceived(NwkFrame_t *frame);
+void nwkRouteFrameOverheard(NwkFrame_t *frame);
 void nwkRouteFrameSent(NwkFrame_t *frame);
 void nwkRoutePrepareTx(NwkFrame_t *frame);
 void nwkRouteFrame(NwkFrame_t *frame);
@@ -57,14 +57,36 @@
 #define NWK_SECURITY_KEY_SIZE        16
 #define NWK_SECURITY_BLOCK_SIZE      16
 
+/*- Types ------------------------------------------------------------------*/
+#ifdef NWK_ENABLE_KEY_TABLE
+enum
+{
+  NWK_KEY_TYPE_NONE  = 0,
+  NWK_KEY_TYPE_LINK  = 1,
+  NWK_KEY_TYPE_GROUP = 2,
+};
+#endif
+
 /*- Prototypes -------------------------------------------------------------*/
 #ifdef NWK_ENABLE_SECURITY
 
 void NWK_SetSecurityKey(uint8_t *key);
+#ifdef NWK_ENABLE_KEY_TABLE
+bool NWK_SetLinkKey(uint8_t id, uint16_t addr, uint8_t *key);
+bool NWK_SetGroupKey(uint8_t id, uint16_t group, uint8_t *key);
+void NWK_RemoveKey(uint8_t id);
+#endif
+#ifdef NWK_ENABLE_FRAME_COUNTER
+void NWK_SetFrameCounter(uint32_t counter);
+void NWK_SetFrameCounterHandler(void (*handler)(uint32_t counter));
+#endif
 
 void nwkSecurityInit(void);
 void nwkSecurityProcess(NwkFrame_t *frame, bool encrypt);
 void nwkSecurityTaskHandler(void);
+#ifdef NWK_ENABLE_KEY_TABLE
+void nwkSecurityKeyIndexInit(NwkFrame_t *frame, uint16_t dstAddr, bool multicast);
+#endif
 
 #endif // NWK_ENABLE_SECURITY
 
@@ -65,6 +65,8 @@ enum
 void nwkTxInit(void);
 void nwkTxFrame(NwkFrame_t *frame);
 void nwkTxBroadcastFrame(NwkFrame_t *frame);
+void nwkTxBroadcastHeard(NwkFrame_t *frame);
+void nwkTxBroadcastCopyHeard(uint16_t src, uint8_t seq, int8_t rssi);
 bool nwkTxAckReceived(NWK_DataInd_t *ind);
 void nwkTxConfirm(NwkFrame_t *frame, uint8_t status);
 void nwkTxEncryptConf(NwkFrame_t *frame);
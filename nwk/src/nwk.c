@@ -58,6 +58,9 @@
 #include "nwkRoute.h"
 #include "nwkSecurity.h"
 #include "nwkRouteDiscovery.h"
+#include "nwkCollection.h"
+#include "nwkSourceRoute.h"
+#include "nwkMulticastTrickle.h"
 
 /*- Variables --------------------------------------------------------------*/
 NwkIb_t nwkIb;
@@ -71,8 +74,12 @@ void NWK_Init(void)
 {
   nwkIb.nwkSeqNum = 0;
   nwkIb.macSeqNum = 0;
+  nwkIb.dataRate = 0;
   nwkIb.addr = 0;
   nwkIb.lock = 0;
+#ifdef NWK_ENABLE_HOP_LIMIT
+  nwkIb.hopLimitDrops = 0;
+#endif
 
   for (uint8_t i = 0; i < NWK_ENDPOINTS_AMOUNT; i++)
     nwkIb.endpoint[i] = NULL;
@@ -97,6 +104,22 @@ void NWK_Init(void)
 #ifdef NWK_ENABLE_ROUTE_DISCOVERY
   nwkRouteDiscoveryInit();
 #endif
+
+#ifdef NWK_ENABLE_COLLECTION
+  nwkCollectionInit();
+#endif
+
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+  nwkSourceRouteInit();
+#endif
+
+#ifdef NWK_ENABLE_MULTICAST_TRICKLE
+  nwkMulticastTrickleInit();
+#endif
+
+#ifdef NWK_ENABLE_OVERHEARING
+  PHY_SetPromiscuousMode(true);
+#endif
 }
 
 /*************************************************************************//**
@@ -119,6 +142,21 @@ void NWK_SetPanId(uint16_t panId)
   PHY_SetPanId(panId);
 }
 
+#ifdef PHY_HAS_HIGH_DATA_RATES
+/*************************************************************************//**
+  @brief Sets the radio data rate of the node
+  @param[in] rate One of the PHY_DATA_RATE_* values
+
+  Acknowledgement wait time and broadcast jitter are divided by the speed up
+  over 250 kb/s, so all nodes of the network should use the same rate.
+*****************************************************************************/
+void NWK_SetDataRate(uint8_t rate)
+{
+  nwkIb.dataRate = rate;
+  PHY_SetDataRate(rate);
+}
+#endif
+
 /*************************************************************************//**
   @brief Registers callback @a ind for the endpoint @a endpoint
   @param[in] id Endpoint index (1-15)
@@ -0,0 +1,400 @@
+/**
+ * \file nwkCollection.c
+ *
+ * \brief Collection tree routing implementation
+ *
+ * Copyright (C) 2012-2014, Atmel Corporation. All rights reserved.
+ *
+ * \asf_license_start
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. The name of Atmel may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. This software may only be redistributed and used in connection with an
+ *    Atmel microcontroller product.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * EXPRESSLY AND SPECIFICALLY DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \asf_license_stop
+ *
+ * Modification and other use of this code is subject to Atmel's Limited
+ * License Agreement (license.txt).
+ *
+ * $Id$
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sysTypes.h"
+#include "sysTimer.h"
+#include "sysConfig.h"
+#include "nwk.h"
+#include "nwkTx.h"
+#include "nwkFrame.h"
+#include "nwkRoute.h"
+#include "nwkCommand.h"
+#include "nwkCollection.h"
+
+#ifdef NWK_ENABLE_COLLECTION
+
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_COLLECTION_PERFECT_LINK_COST   16
+
+/*- Prototypes -------------------------------------------------------------*/
+static void nwkCollectionTimerHandler(SYS_Timer_t *timer);
+static void nwkCollectionTrickleReset(void);
+static void nwkCollectionTrickleStart(void);
+static void nwkCollectionSendAdvertisement(void);
+static void nwkCollectionSetParent(uint16_t sink, uint16_t parent, uint16_t cost, uint8_t lqi);
+static void nwkCollectionParentLost(void);
+static uint16_t nwkCollectionLinkCost(uint8_t lqi);
+
+/*- Variables --------------------------------------------------------------*/
+static bool nwkCollectionSink;
+static uint16_t nwkCollectionSinkAddr;
+static uint16_t nwkCollectionParent;
+static uint16_t nwkCollectionCostValue;
+static uint16_t nwkCollectionLostCost;
+static uint8_t nwkCollectionParentFailures;
+
+static uint32_t nwkCollectionInterval;
+static uint32_t nwkCollectionTxTime;
+static uint8_t nwkCollectionCounter;
+static bool nwkCollectionTxPhase;
+static SYS_Timer_t nwkCollectionTimer;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Initializes the Collection module
+*****************************************************************************/
+void nwkCollectionInit(void)
+{
+  nwkCollectionSink = false;
+  nwkCollectionSinkAddr = NWK_ROUTE_UNKNOWN;
+  nwkCollectionParent = NWK_ROUTE_UNKNOWN;
+  nwkCollectionCostValue = NWK_COLLECTION_NO_ROUTE;
+  nwkCollectionLostCost = NWK_COLLECTION_NO_ROUTE;
+  nwkCollectionParentFailures = 0;
+
+  nwkCollectionTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkCollectionTimer.handler = nwkCollectionTimerHandler;
+}
+
+/*************************************************************************//**
+  @brief Makes this node a sink (root) of the collection tree
+  @param[in] sink @c true to start advertising the node as a sink
+
+  Must be called after the node address is set with NWK_SetAddr().
+*****************************************************************************/
+void NWK_CollectionSetSink(bool sink)
+{
+  if (sink)
+  {
+    nwkCollectionParentLost();
+    nwkCollectionSink = true;
+    nwkCollectionSinkAddr = nwkIb.addr;
+    nwkCollectionCostValue = 0;
+  }
+  else if (nwkCollectionSink)
+  {
+    nwkCollectionSink = false;
+    nwkCollectionSinkAddr = NWK_ROUTE_UNKNOWN;
+    nwkCollectionCostValue = NWK_COLLECTION_NO_ROUTE;
+  }
+
+  nwkCollectionTrickleReset();
+}
+
+/*************************************************************************//**
+  @brief Returns the address of the sink this node is connected to
+  @return Sink address or @c NWK_ROUTE_UNKNOWN if there is no route to a sink
+*****************************************************************************/
+uint16_t NWK_CollectionSinkAddr(void)
+{
+  if (NWK_COLLECTION_NO_ROUTE == nwkCollectionCostValue)
+    return NWK_ROUTE_UNKNOWN;
+  return nwkCollectionSinkAddr;
+}
+
+/*************************************************************************//**
+  @brief Returns the address of the current parent in the collection tree
+  @return Parent address or @c NWK_ROUTE_UNKNOWN if there is no parent
+*****************************************************************************/
+uint16_t NWK_CollectionParentAddr(void)
+{
+  return nwkCollectionParent;
+}
+
+/*************************************************************************//**
+  @brief Returns the cost of the path to the sink
+  @return Path cost or @c NWK_COLLECTION_NO_ROUTE if there is no route
+*****************************************************************************/
+uint16_t NWK_CollectionCost(void)
+{
+  return nwkCollectionCostValue;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+bool nwkCollectionAdvertisementReceived(NWK_DataInd_t *ind)
+{
+  NwkCommandCollectionAdvertisement_t *command =
+      (NwkCommandCollectionAdvertisement_t *)ind->data;
+  uint32_t cost;
+
+  if (sizeof(NwkCommandCollectionAdvertisement_t) != ind->size)
+    return false;
+
+  if (nwkCollectionSink || ind->srcAddr == nwkIb.addr)
+    return true;
+
+  if (NWK_COLLECTION_NO_ROUTE == command->cost)
+  {
+    if (ind->srcAddr == nwkCollectionParent)
+      nwkCollectionParentLost();
+    else if (NWK_COLLECTION_NO_ROUTE != nwkCollectionCostValue)
+      nwkCollectionTrickleReset();
+    return true;
+  }
+
+  cost = (uint32_t)command->cost + nwkCollectionLinkCost(ind->lqi);
+
+  if (cost >= NWK_COLLECTION_MAX_COST)
+  {
+    if (ind->srcAddr == nwkCollectionParent)
+      nwkCollectionParentLost();
+    return true;
+  }
+
+  if (ind->srcAddr == nwkCollectionParent)
+  {
+    bool changed = (command->sinkAddr != nwkCollectionSinkAddr) ||
+        (cost > (uint32_t)nwkCollectionCostValue + NWK_COLLECTION_PARENT_SWITCH_THRESHOLD) ||
+        (cost + NWK_COLLECTION_PARENT_SWITCH_THRESHOLD < nwkCollectionCostValue);
+
+    nwkCollectionSetParent(command->sinkAddr, ind->srcAddr, cost, ind->lqi);
+
+    if (changed)
+      nwkCollectionTrickleReset();
+    else
+      nwkCollectionCounter++;
+  }
+  else if (command->cost < nwkCollectionLostCost &&
+      cost + NWK_COLLECTION_PARENT_SWITCH_THRESHOLD < nwkCollectionCostValue)
+  {
+    nwkCollectionSetParent(command->sinkAddr, ind->srcAddr, cost, ind->lqi);
+    nwkCollectionTrickleReset();
+  }
+  else
+  {
+    nwkCollectionCounter++;
+  }
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Tracks delivery of the upward frames to the current parent
+  @param[in] frame Pointer to the sent frame
+*****************************************************************************/
+void nwkCollectionFrameSent(NwkFrame_t *frame)
+{
+  if (NWK_ROUTE_UNKNOWN == nwkCollectionParent ||
+      frame->header.nwkDstAddr != nwkCollectionSinkAddr ||
+      frame->header.macDstAddr != nwkCollectionParent)
+    return;
+
+  if (NWK_PHY_NO_ACK_STATUS != frame->tx.status)
+  {
+    if (NWK_SUCCESS_STATUS == frame->tx.status)
+      nwkCollectionParentFailures = 0;
+    return;
+  }
+
+  if (++nwkCollectionParentFailures >= NWK_COLLECTION_PARENT_MAX_FAILURES)
+  {
+    nwkCollectionParentLost();
+    nwkCollectionTrickleReset();
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkCollectionSetParent(uint16_t sink, uint16_t parent, uint16_t cost, uint8_t lqi)
+{
+  NWK_RouteTableEntry_t *entry;
+
+  if (sink != nwkCollectionSinkAddr && NWK_ROUTE_UNKNOWN != nwkCollectionParent)
+    nwkCollectionParentLost();
+
+  entry = NWK_RouteFindEntry(sink, 0);
+
+  // Fixed routes installed by the application take precedence
+  if (entry && entry->fixed && !entry->collection)
+    return;
+
+  if (NULL == entry)
+    entry = NWK_RouteNewEntry();
+
+  if (NULL == entry)
+    return;
+
+  entry->fixed = 1;
+  entry->collection = 1;
+  entry->multicast = 0;
+  entry->dstAddr = sink;
+  entry->nextHopAddr = parent;
+  entry->score = NWK_ROUTE_DEFAULT_SCORE;
+  entry->lqi = lqi;
+
+  if (parent != nwkCollectionParent)
+    nwkCollectionParentFailures = 0;
+
+  nwkCollectionSinkAddr = sink;
+  nwkCollectionParent = parent;
+  nwkCollectionCostValue = cost;
+  nwkCollectionLostCost = NWK_COLLECTION_NO_ROUTE;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkCollectionParentLost(void)
+{
+  NWK_RouteTableEntry_t *entry;
+
+  if (NWK_ROUTE_UNKNOWN == nwkCollectionParent)
+    return;
+
+  entry = NWK_RouteFindEntry(nwkCollectionSinkAddr, 0);
+
+  if (entry && entry->collection)
+  {
+    entry->fixed = 0;
+    entry->collection = 0;
+    NWK_RouteFreeEntry(entry);
+  }
+
+  nwkCollectionLostCost = nwkCollectionCostValue;
+  nwkCollectionParent = NWK_ROUTE_UNKNOWN;
+  nwkCollectionCostValue = NWK_COLLECTION_NO_ROUTE;
+  nwkCollectionParentFailures = 0;
+}
+
+/*************************************************************************//**
+  @brief Calculates the cost of the link based on its LQI
+  @param[in] lqi LQI value as provided by the transceiver
+  @return Link cost, equals to NWK_COLLECTION_PERFECT_LINK_COST for a perfect
+          link and grows with expected number of transmissions
+*****************************************************************************/
+static uint16_t nwkCollectionLinkCost(uint8_t lqi)
+{
+  return (NWK_COLLECTION_PERFECT_LINK_COST * 255u) / NWK_LinearizeLqi(lqi);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkCollectionSendAdvertisement(void)
+{
+  NwkFrame_t *frame;
+  NwkCommandCollectionAdvertisement_t *command;
+
+  if (nwkIb.addr & NWK_ROUTE_NON_ROUTING)
+    return;
+
+  if (NULL == (frame = nwkFrameAlloc()))
+    return;
+
+  nwkFrameCommandInit(frame);
+
+  frame->size += sizeof(NwkCommandCollectionAdvertisement_t);
+  frame->tx.confirm = NULL;
+
+  frame->header.nwkFcf.linkLocal = 1;
+  frame->header.nwkDstAddr = NWK_BROADCAST_ADDR;
+
+  command = (NwkCommandCollectionAdvertisement_t *)frame->payload;
+  command->id = NWK_COMMAND_COLLECTION_ADVERTISEMENT;
+  command->sinkAddr = nwkCollectionSinkAddr;
+  command->cost = nwkCollectionCostValue;
+
+  nwkTxFrame(frame);
+}
+
+/*************************************************************************//**
+  @brief Restarts the Trickle timer from the minimal interval
+*****************************************************************************/
+static void nwkCollectionTrickleReset(void)
+{
+  nwkCollectionInterval = NWK_COLLECTION_TRICKLE_IMIN;
+  SYS_TimerStop(&nwkCollectionTimer);
+  nwkCollectionTrickleStart();
+}
+
+/*************************************************************************//**
+  @brief Starts a new Trickle interval and picks a transmission time in it
+*****************************************************************************/
+static void nwkCollectionTrickleStart(void)
+{
+  uint32_t half = nwkCollectionInterval / 2;
+
+  nwkCollectionCounter = 0;
+  nwkCollectionTxTime = half + ((uint32_t)rand() % (half + 1));
+  nwkCollectionTxPhase = true;
+
+  nwkCollectionTimer.interval = nwkCollectionTxTime;
+  SYS_TimerStart(&nwkCollectionTimer);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkCollectionTimerHandler(SYS_Timer_t *timer)
+{
+  if (nwkCollectionTxPhase)
+  {
+    bool advertise = nwkCollectionSink || NWK_ROUTE_UNKNOWN != nwkCollectionParent ||
+        NWK_COLLECTION_NO_ROUTE != nwkCollectionLostCost;
+
+    if (advertise && nwkCollectionCounter < NWK_COLLECTION_TRICKLE_K)
+      nwkCollectionSendAdvertisement();
+
+    nwkCollectionTxPhase = false;
+    timer->interval = nwkCollectionInterval - nwkCollectionTxTime;
+    SYS_TimerStart(timer);
+  }
+  else
+  {
+    nwkCollectionLostCost = NWK_COLLECTION_NO_ROUTE;
+
+    nwkCollectionInterval *= 2;
+    if (nwkCollectionInterval > NWK_COLLECTION_TRICKLE_IMAX)
+      nwkCollectionInterval = NWK_COLLECTION_TRICKLE_IMAX;
+
+    nwkCollectionTrickleStart();
+  }
+}
+
+#endif // NWK_ENABLE_COLLECTION
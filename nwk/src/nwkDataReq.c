@@ -55,6 +55,7 @@
 #include "nwkFrame.h"
 #include "nwkGroup.h"
 #include "nwkDataReq.h"
+#include "nwkSourceRoute.h"
 
 /*- Types ------------------------------------------------------------------*/
 enum
@@ -66,6 +67,7 @@ enum
 
 /*- Prototypes -------------------------------------------------------------*/
 static void nwkDataReqTxConf(NwkFrame_t *frame);
+static uint8_t nwkDataReqOverhead(NwkFrame_t *frame);
 
 /*- Variables --------------------------------------------------------------*/
 static NWK_DataReq_t *nwkDataReqQueue;
@@ -104,6 +106,33 @@ void NWK_DataReq(NWK_DataReq_t *req)
   }
 }
 
+/*************************************************************************//**
+  @brief Returns the number of bytes added to the @a frame after the payload
+    has been copied
+  @param[in] frame Pointer to the frame with all headers initialized
+*****************************************************************************/
+static uint8_t nwkDataReqOverhead(NwkFrame_t *frame)
+{
+  uint8_t size = 0;
+
+#ifdef NWK_ENABLE_SECURITY
+  if (frame->header.nwkFcf.security)
+    size += NWK_SECURITY_MIC_SIZE;
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  if (frame->header.nwkFcf.security)
+    size += sizeof(uint32_t);
+#endif
+#else
+  (void)frame;
+#endif
+
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+  size += nwkSourceRouteRecordSize(frame);
+#endif
+
+  return size;
+}
+
 /*************************************************************************//**
   @brief Prepares and send outgoing frame based on the request @a req parameters
   @param[in] req Pointer to the request parameters
@@ -128,10 +157,20 @@ static void nwkDataReqSendFrame(NWK_DataReq_t *req)
   frame->header.nwkFcf.ackRequest = req->options & NWK_OPT_ACK_REQUEST ? 1 : 0;
   frame->header.nwkFcf.linkLocal = req->options & NWK_OPT_LINK_LOCAL ? 1 : 0;
 
+#ifdef NWK_ENABLE_HOP_LIMIT
+  if (0 == frame->header.nwkFcf.linkLocal)
+    nwkFrameHopLimitInit(frame);
+#endif
+
 #ifdef NWK_ENABLE_SECURITY
   frame->header.nwkFcf.security = req->options & NWK_OPT_ENABLE_SECURITY ? 1 : 0;
 #endif
 
+#ifdef NWK_ENABLE_KEY_TABLE
+  if (frame->header.nwkFcf.security)
+    nwkSecurityKeyIndexInit(frame, req->dstAddr, req->options & NWK_OPT_MULTICAST);
+#endif
+
 #ifdef NWK_ENABLE_MULTICAST
   frame->header.nwkFcf.multicast = req->options & NWK_OPT_MULTICAST ? 1 : 0;
 
@@ -149,15 +188,29 @@ static void nwkDataReqSendFrame(NWK_DataReq_t *req)
   }
 #endif
 
-  frame->header.nwkSeq = ++nwkIb.nwkSeqNum;
   frame->header.nwkSrcAddr = nwkIb.addr;
   frame->header.nwkDstAddr = req->dstAddr;
   frame->header.nwkSrcEndpoint = req->srcEndpoint;
   frame->header.nwkDstEndpoint = req->dstEndpoint;
 
+  if (frame->size + req->size + nwkDataReqOverhead(frame) > NWK_FRAME_MAX_PAYLOAD_SIZE - 2/*crc*/)
+  {
+    nwkFrameFree(frame);
+    req->frame = NULL;
+    req->state = NWK_DATA_REQ_STATE_CONFIRM;
+    req->status = NWK_ERROR_STATUS;
+    return;
+  }
+
+  frame->header.nwkSeq = ++nwkIb.nwkSeqNum;
+
   memcpy(frame->payload, req->data, req->size);
   frame->size += req->size;
 
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+  nwkSourceRouteRecordInit(frame);
+#endif
+
   nwkTxFrame(frame);
 }
 
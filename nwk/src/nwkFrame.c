@@ -136,4 +136,43 @@ void nwkFrameCommandInit(NwkFrame_t *frame)
 #ifdef NWK_ENABLE_SECURE_COMMANDS
   frame->header.nwkFcf.security = 1;
 #endif
+#ifdef NWK_ENABLE_HOP_LIMIT
+  nwkFrameHopLimitInit(frame);
+#endif
 }
+
+#ifdef NWK_ENABLE_HOP_LIMIT
+/*************************************************************************//**
+  @brief Adds a hop limit field to the @a frame with an empty payload
+  @param[in] frame Pointer to the frame
+*****************************************************************************/
+void nwkFrameHopLimitInit(NwkFrame_t *frame)
+{
+  frame->header.nwkFcf.hopLimit = 1;
+  *nwkFrameHopLimit(frame) = NWK_MAX_HOPS;
+  frame->payload++;
+  frame->size++;
+}
+
+/*************************************************************************//**
+  @brief Decrements the hop limit of the @a frame before forwarding it
+  @param[in] frame Pointer to the frame
+  @return @c false if the hop limit is exhausted and the frame must be dropped
+*****************************************************************************/
+bool nwkFrameDecrementHopLimit(NwkFrame_t *frame)
+{
+  uint8_t *hopLimit = nwkFrameHopLimit(frame);
+
+  if (0 == frame->header.nwkFcf.hopLimit)
+    return true;
+
+  if (*hopLimit <= 1)
+  {
+    nwkIb.hopLimitDrops++;
+    return false;
+  }
+
+  (*hopLimit)--;
+  return true;
+}
+#endif
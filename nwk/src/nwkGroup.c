@@ -50,17 +50,34 @@
 #include <stdbool.h>
 #include <string.h>
 #include "sysConfig.h"
+#include "nwk.h"
+#include "nwkGroup.h"
+#include "nwkCommand.h"
 
 #ifdef NWK_ENABLE_MULTICAST
 
 /*- Definitions ------------------------------------------------------------*/
 #define NWK_GROUP_FREE      0xffff
 
+#if NWK_GROUPS_MODE == 2
+  #define NWK_GROUPS_BITMAP_SIZE   ((NWK_GROUPS_AMOUNT + 7) / 8)
+#endif
+
 /*- Prototypes -------------------------------------------------------------*/
+#if NWK_GROUPS_MODE == 0
 static bool nwkGroupSwitch(uint16_t from, uint16_t to);
+#endif
 
 /*- Variables --------------------------------------------------------------*/
+#if NWK_GROUPS_MODE == 2
+static uint8_t nwkGroupsBitmap[NWK_GROUPS_BITMAP_SIZE];
+#else
 static uint16_t nwkGroups[NWK_GROUPS_AMOUNT];
+#endif
+
+#if NWK_GROUPS_MODE == 1
+static uint8_t nwkGroupsCount;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -69,10 +86,18 @@ static uint16_t nwkGroups[NWK_GROUPS_AMOUNT];
 *****************************************************************************/
 void nwkGroupInit(void)
 {
+#if NWK_GROUPS_MODE == 0
   for (uint8_t i = 0; i < NWK_GROUPS_AMOUNT; i++)
     nwkGroups[i] = NWK_GROUP_FREE;
+#elif NWK_GROUPS_MODE == 1
+  nwkGroupsCount = 0;
+#else
+  memset(nwkGroupsBitmap, 0, sizeof(nwkGroupsBitmap));
+#endif
 }
 
+#if NWK_GROUPS_MODE == 0
+
 /*************************************************************************//**
   @brief Adds node to the @a group
   @param[in] group Group ID
@@ -125,4 +150,240 @@ static bool nwkGroupSwitch(uint16_t from, uint16_t to)
   return false;
 }
 
+#elif NWK_GROUPS_MODE == 1
+
+/*************************************************************************//**
+  @brief Finds a position of the @a group in the sorted group table
+  @param[in] group Group ID
+  @param[out] index Index of the group or the position to insert it to
+  @return @c true if the group was found and @c false otherwise
+*****************************************************************************/
+static bool nwkGroupSearch(uint16_t group, uint8_t *index)
+{
+  uint8_t low = 0;
+  uint8_t high = nwkGroupsCount;
+
+  while (low < high)
+  {
+    uint8_t mid = (low + high) / 2;
+
+    if (nwkGroups[mid] < group)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  *index = low;
+  return low < nwkGroupsCount && group == nwkGroups[low];
+}
+
+/*************************************************************************//**
+  @brief Adds node to the @a group
+  @param[in] group Group ID
+  @return @c true in case of success and @c false otherwise
+*****************************************************************************/
+bool NWK_GroupAdd(uint16_t group)
+{
+  uint8_t index;
+
+  if (nwkGroupSearch(group, &index))
+    return true;
+
+  if (NWK_GROUPS_AMOUNT == nwkGroupsCount)
+    return false;
+
+  memmove(&nwkGroups[index + 1], &nwkGroups[index],
+      (nwkGroupsCount - index) * sizeof(uint16_t));
+  nwkGroups[index] = group;
+  nwkGroupsCount++;
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Removes node from the @a group
+  @param[in] group Group ID
+  @return @c true in case of success and @c false otherwise
+*****************************************************************************/
+bool NWK_GroupRemove(uint16_t group)
+{
+  uint8_t index;
+
+  if (!nwkGroupSearch(group, &index))
+    return false;
+
+  nwkGroupsCount--;
+  memmove(&nwkGroups[index], &nwkGroups[index + 1],
+      (nwkGroupsCount - index) * sizeof(uint16_t));
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Verifies if node is a member of the @a group
+  @param[in] group Group ID
+  @return @c true if node is a member of the group and @c false otherwise
+*****************************************************************************/
+bool NWK_GroupIsMember(uint16_t group)
+{
+  uint8_t index;
+
+  return nwkGroupSearch(group, &index);
+}
+
+#else // NWK_GROUPS_MODE == 2
+
+/*************************************************************************//**
+  @brief Adds node to the @a group
+  @param[in] group Group ID
+  @return @c true in case of success and @c false if the group is out of range
+*****************************************************************************/
+bool NWK_GroupAdd(uint16_t group)
+{
+  uint16_t bit = group - NWK_GROUPS_BITMAP_BASE;
+
+  if (bit >= NWK_GROUPS_AMOUNT)
+    return false;
+
+  nwkGroupsBitmap[bit / 8] |= (1 << (bit % 8));
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Removes node from the @a group
+  @param[in] group Group ID
+  @return @c true in case of success and @c false otherwise
+*****************************************************************************/
+bool NWK_GroupRemove(uint16_t group)
+{
+  if (!NWK_GroupIsMember(group))
+    return false;
+
+  group -= NWK_GROUPS_BITMAP_BASE;
+  nwkGroupsBitmap[group / 8] &= ~(1 << (group % 8));
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Verifies if node is a member of the @a group
+  @param[in] group Group ID
+  @return @c true if node is a member of the group and @c false otherwise
+*****************************************************************************/
+bool NWK_GroupIsMember(uint16_t group)
+{
+  uint16_t bit = group - NWK_GROUPS_BITMAP_BASE;
+
+  if (bit >= NWK_GROUPS_AMOUNT)
+    return false;
+
+  return nwkGroupsBitmap[bit / 8] & (1 << (bit % 8));
+}
+
+#endif // NWK_GROUPS_MODE
+
+/*************************************************************************//**
+  @brief Adds node to the @a count groups from the @a groups list
+  @param[in] groups List of group IDs
+  @param[in] count Number of groups in the list
+  @return Number of groups added before the first failure
+*****************************************************************************/
+uint8_t NWK_GroupAddList(uint16_t *groups, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!NWK_GroupAdd(groups[i]))
+      return i;
+  }
+  return count;
+}
+
+/*************************************************************************//**
+  @brief Removes node from the @a count groups from the @a groups list
+  @param[in] groups List of group IDs
+  @param[in] count Number of groups in the list
+  @return Number of groups the node was removed from
+*****************************************************************************/
+uint8_t NWK_GroupRemoveList(uint16_t *groups, uint8_t count)
+{
+  uint8_t removed = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (NWK_GroupRemove(groups[i]))
+      removed++;
+  }
+  return removed;
+}
+
+#ifdef NWK_ENABLE_GROUP_COMMANDS
+/*************************************************************************//**
+*****************************************************************************/
+static uint8_t nwkGroupCommandPrepare(uint8_t *data, uint8_t id, uint16_t *groups, uint8_t count)
+{
+  NwkCommandGroup_t *command = (NwkCommandGroup_t *)data;
+
+  if (count > NWK_GROUP_COMMAND_MAX_GROUPS)
+    count = NWK_GROUP_COMMAND_MAX_GROUPS;
+
+  command->id = id;
+  memcpy(command->group, groups, count * sizeof(uint16_t));
+
+  return sizeof(NwkCommandGroup_t) + count * sizeof(uint16_t);
+}
+
+/*************************************************************************//**
+  @brief Prepares a command that adds the receiving nodes to the @a groups
+  @param[out] data Buffer for the command, must hold up to
+                   (1 + 2 * NWK_GROUP_COMMAND_MAX_GROUPS) bytes
+  @param[in] groups List of group IDs
+  @param[in] count Number of groups in the list, only the first
+                   NWK_GROUP_COMMAND_MAX_GROUPS are used
+  @return Size of the command
+
+  The command must be sent to NWK_SERVICE_ENDPOINT_ID with NWK_DataReq().
+  It may be addressed to a single node, a group (NWK_OPT_MULTICAST) or
+  broadcast. When security is enabled, only secured commands are accepted.
+*****************************************************************************/
+uint8_t NWK_GroupAddCommand(uint8_t *data, uint16_t *groups, uint8_t count)
+{
+  return nwkGroupCommandPrepare(data, NWK_COMMAND_GROUP_ADD, groups, count);
+}
+
+/*************************************************************************//**
+  @brief Prepares a command that removes the receiving nodes from the @a groups
+  @see NWK_GroupAddCommand()
+*****************************************************************************/
+uint8_t NWK_GroupRemoveCommand(uint8_t *data, uint16_t *groups, uint8_t count)
+{
+  return nwkGroupCommandPrepare(data, NWK_COMMAND_GROUP_REMOVE, groups, count);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+bool nwkGroupCommandReceived(NWK_DataInd_t *ind)
+{
+  NwkCommandGroup_t *command = (NwkCommandGroup_t *)ind->data;
+  uint8_t count = (ind->size - sizeof(NwkCommandGroup_t)) / sizeof(uint16_t);
+  uint16_t groups[NWK_GROUP_COMMAND_MAX_GROUPS];
+
+#ifdef NWK_ENABLE_SECURITY
+  if (0 == (ind->options & NWK_IND_OPT_SECURED))
+    return false;
+#endif
+
+  if (0 == (ind->size & 1) || 0 == count || count > NWK_GROUP_COMMAND_MAX_GROUPS)
+    return false;
+
+  // Group list in the frame is not aligned
+  memcpy(groups, command->group, count * sizeof(uint16_t));
+
+  if (NWK_COMMAND_GROUP_ADD == command->id)
+    NWK_GroupAddList(groups, count);
+  else
+    NWK_GroupRemoveList(groups, count);
+
+  return true;
+}
+#endif // NWK_ENABLE_GROUP_COMMANDS
+
 #endif // NWK_ENABLE_MULTICAST
@@ -0,0 +1,225 @@
+/**
+ * \file nwkMulticastTrickle.c
+ *
+ * \brief Trickle multicast forwarding implementation
+ *
+ * Copyright (C) 2012-2014, Atmel Corporation. All rights reserved.
+ *
+ * \asf_license_start
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. The name of Atmel may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. This software may only be redistributed and used in connection with an
+ *    Atmel microcontroller product.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * EXPRESSLY AND SPECIFICALLY DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \asf_license_stop
+ *
+ * Modification and other use of this code is subject to Atmel's Limited
+ * License Agreement (license.txt).
+ *
+ * $Id$
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sysTypes.h"
+#include "sysTimer.h"
+#include "sysConfig.h"
+#include "nwk.h"
+#include "nwkTx.h"
+#include "nwkFrame.h"
+#include "nwkMulticastTrickle.h"
+
+#ifdef NWK_ENABLE_MULTICAST_TRICKLE
+
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_MULTICAST_TRICKLE_TIMER_INTERVAL   10 // ms
+
+#if (NWK_MULTICAST_TRICKLE_IMIN << NWK_MULTICAST_TRICKLE_EXPIRATIONS) > NWK_DUPLICATE_REJECTION_TTL
+  #error Buffered multicast frames must expire before their duplicate rejection entries
+#endif
+
+/*- Types ------------------------------------------------------------------*/
+enum
+{
+  NWK_MULTICAST_TRICKLE_STATE_BUFFERED = 0x50,
+};
+
+typedef struct NwkMulticastTrickleEntry_t
+{
+  NwkFrame_t *frame;
+  uint16_t   interval;
+  uint16_t   txTime;
+  uint16_t   time;
+  uint8_t    counter;
+  uint8_t    expirations;
+} NwkMulticastTrickleEntry_t;
+
+/*- Prototypes -------------------------------------------------------------*/
+static void nwkMulticastTrickleTimerHandler(SYS_Timer_t *timer);
+
+/*- Variables --------------------------------------------------------------*/
+static NwkMulticastTrickleEntry_t nwkMulticastTrickleTable[NWK_MULTICAST_TRICKLE_BUFFERS];
+static SYS_Timer_t nwkMulticastTrickleTimer;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Initializes the Trickle Multicast module
+*****************************************************************************/
+void nwkMulticastTrickleInit(void)
+{
+  for (uint8_t i = 0; i < NWK_MULTICAST_TRICKLE_BUFFERS; i++)
+    nwkMulticastTrickleTable[i].frame = NULL;
+
+  nwkMulticastTrickleTimer.interval = NWK_MULTICAST_TRICKLE_TIMER_INTERVAL;
+  nwkMulticastTrickleTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkMulticastTrickleTimer.handler = nwkMulticastTrickleTimerHandler;
+}
+
+/*************************************************************************//**
+  @brief Starts a new Trickle interval for the buffered frame @a entry
+*****************************************************************************/
+static void nwkMulticastTrickleStartInterval(NwkMulticastTrickleEntry_t *entry)
+{
+  uint16_t half = entry->interval / 2;
+
+  entry->time = 0;
+  entry->counter = 0;
+  entry->txTime = half + (rand() % (half + 1));
+}
+
+/*************************************************************************//**
+  @brief Buffers a received multicast @a frame for Trickle retransmission
+
+  Instead of being rebroadcast immediately, the frame is retransmitted once
+  per Trickle interval unless NWK_MULTICAST_TRICKLE_K copies were heard from
+  the neighbours in the same interval.
+*****************************************************************************/
+void nwkMulticastTrickleFrame(NwkFrame_t *frame)
+{
+  NwkMulticastTrickleEntry_t *entry = NULL;
+  NwkFrame_t *newFrame;
+
+  for (uint8_t i = 0; i < NWK_MULTICAST_TRICKLE_BUFFERS; i++)
+  {
+    if (NULL == nwkMulticastTrickleTable[i].frame)
+    {
+      entry = &nwkMulticastTrickleTable[i];
+      break;
+    }
+  }
+
+  if (NULL == entry)
+  {
+    nwkTxBroadcastFrame(frame);
+    return;
+  }
+
+  if (NULL == (newFrame = nwkFrameAlloc()))
+    return;
+
+  newFrame->state = NWK_MULTICAST_TRICKLE_STATE_BUFFERED;
+  newFrame->size = frame->size;
+  memcpy(newFrame->data, frame->data, frame->size);
+
+  entry->frame = newFrame;
+  entry->interval = NWK_MULTICAST_TRICKLE_IMIN;
+  entry->expirations = 0;
+  nwkMulticastTrickleStartInterval(entry);
+
+  SYS_TimerStart(&nwkMulticastTrickleTimer);
+}
+
+/*************************************************************************//**
+  @brief Counts a copy of a buffered multicast @a frame heard from a neighbour
+*****************************************************************************/
+void nwkMulticastTrickleHeard(NwkFrame_t *frame)
+{
+  for (uint8_t i = 0; i < NWK_MULTICAST_TRICKLE_BUFFERS; i++)
+  {
+    NwkMulticastTrickleEntry_t *entry = &nwkMulticastTrickleTable[i];
+
+    if (entry->frame && entry->frame->header.nwkSrcAddr == frame->header.nwkSrcAddr &&
+        entry->frame->header.nwkSeq == frame->header.nwkSeq)
+    {
+      if (entry->counter < 0xff)
+        entry->counter++;
+      return;
+    }
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkMulticastTrickleTimerHandler(SYS_Timer_t *timer)
+{
+  bool restart = false;
+
+  for (uint8_t i = 0; i < NWK_MULTICAST_TRICKLE_BUFFERS; i++)
+  {
+    NwkMulticastTrickleEntry_t *entry = &nwkMulticastTrickleTable[i];
+    uint16_t time;
+
+    if (NULL == entry->frame)
+      continue;
+
+    time = entry->time + NWK_MULTICAST_TRICKLE_TIMER_INTERVAL;
+
+    if (entry->time < entry->txTime && time >= entry->txTime &&
+        entry->counter < NWK_MULTICAST_TRICKLE_K)
+      nwkTxBroadcastFrame(entry->frame);
+
+    entry->time = time;
+
+    if (entry->time >= entry->interval)
+    {
+      if (++entry->expirations == NWK_MULTICAST_TRICKLE_EXPIRATIONS)
+      {
+        nwkFrameFree(entry->frame);
+        entry->frame = NULL;
+        continue;
+      }
+
+      entry->interval *= 2;
+      if (entry->interval > NWK_MULTICAST_TRICKLE_IMAX)
+        entry->interval = NWK_MULTICAST_TRICKLE_IMAX;
+
+      nwkMulticastTrickleStartInterval(entry);
+    }
+
+    restart = true;
+  }
+
+  if (restart)
+    SYS_TimerStart(timer);
+}
+
+#endif // NWK_ENABLE_MULTICAST_TRICKLE
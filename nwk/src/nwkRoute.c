@@ -50,6 +50,7 @@
 #include <stdbool.h>
 #include "sysTypes.h"
 #include "sysConfig.h"
+#include "sysTimer.h"
 #include "nwk.h"
 #include "nwkTx.h"
 #include "nwkFrame.h"
@@ -57,19 +58,38 @@
 #include "nwkGroup.h"
 #include "nwkCommand.h"
 #include "nwkRouteDiscovery.h"
+#include "nwkCollection.h"
+#include "nwkSourceRoute.h"
 
 #ifdef NWK_ENABLE_ROUTING
 
 /*- Definitions ------------------------------------------------------------*/
-#define NWK_ROUTE_MAX_RANK         255
-#define NWK_ROUTE_DEFAULT_RANK     128
+#define NWK_ROUTE_LIST_END         0xff
+#define NWK_ROUTE_ERROR_TIMER_INTERVAL   100 // ms
+#define ROUTE_ERROR_HOLD_DOWN \
+            ((NWK_ROUTE_ERROR_HOLD_DOWN / NWK_ROUTE_ERROR_TIMER_INTERVAL) + 1)
+
+/*- Types ------------------------------------------------------------------*/
+typedef struct NwkRouteErrorEntry_t
+{
+  uint16_t srcAddr;
+  uint16_t dstAddr;
+  uint8_t  multicast : 1;
+  uint8_t  pending   : 1;
+  uint8_t  holdDown;
+} NwkRouteErrorEntry_t;
 
 /*- Prototypes -------------------------------------------------------------*/
-static void nwkRouteSendRouteError(uint16_t src, uint16_t dst, uint8_t multicast);
-static void nwkRouteNormalizeRanks(void);
+static void nwkRouteQueueRouteError(uint16_t src, uint16_t dst, uint8_t multicast);
+static void nwkRouteErrorTimerHandler(SYS_Timer_t *timer);
+static void nwkRouteListInsert(NWK_RouteTableEntry_t *entry, bool head);
 
 /*- Variables --------------------------------------------------------------*/
 static NWK_RouteTableEntry_t nwkRouteTable[NWK_ROUTE_TABLE_SIZE];
+static uint8_t nwkRouteListHead;
+static uint8_t nwkRouteListTail;
+static NwkRouteErrorEntry_t nwkRouteErrorTable[NWK_ROUTE_ERROR_TABLE_SIZE];
+static SYS_Timer_t nwkRouteErrorTimer;
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -78,12 +98,85 @@ static NWK_RouteTableEntry_t nwkRouteTable[NWK_ROUTE_TABLE_SIZE];
 *****************************************************************************/
 void nwkRouteInit(void)
 {
+  nwkRouteListHead = NWK_ROUTE_LIST_END;
+  nwkRouteListTail = NWK_ROUTE_LIST_END;
+
   for (uint8_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
   {
     nwkRouteTable[i].dstAddr = NWK_ROUTE_UNKNOWN;
     nwkRouteTable[i].fixed = 0;
-    nwkRouteTable[i].rank = 0;
+    nwkRouteTable[i].collection = 0;
+    nwkRouteListInsert(&nwkRouteTable[i], false);
+  }
+
+  for (uint8_t i = 0; i < NWK_ROUTE_ERROR_TABLE_SIZE; i++)
+  {
+    nwkRouteErrorTable[i].pending = 0;
+    nwkRouteErrorTable[i].holdDown = 0;
+  }
+
+  nwkRouteErrorTimer.interval = NWK_ROUTE_ERROR_TIMER_INTERVAL;
+  nwkRouteErrorTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkRouteErrorTimer.handler = nwkRouteErrorTimerHandler;
+}
+
+/*************************************************************************//**
+  @brief Links the @a entry to the head (most recently used) or the tail
+         (next to be replaced) of the usage list
+*****************************************************************************/
+static void nwkRouteListInsert(NWK_RouteTableEntry_t *entry, bool head)
+{
+  uint8_t index = entry - nwkRouteTable;
+
+  if (NWK_ROUTE_LIST_END == nwkRouteListHead)
+  {
+    entry->prev = NWK_ROUTE_LIST_END;
+    entry->next = NWK_ROUTE_LIST_END;
+    nwkRouteListHead = index;
+    nwkRouteListTail = index;
+  }
+  else if (head)
+  {
+    entry->prev = NWK_ROUTE_LIST_END;
+    entry->next = nwkRouteListHead;
+    nwkRouteTable[nwkRouteListHead].prev = index;
+    nwkRouteListHead = index;
   }
+  else
+  {
+    entry->prev = nwkRouteListTail;
+    entry->next = NWK_ROUTE_LIST_END;
+    nwkRouteTable[nwkRouteListTail].next = index;
+    nwkRouteListTail = index;
+  }
+}
+
+/*************************************************************************//**
+  @brief Unlinks the @a entry from the usage list
+*****************************************************************************/
+static void nwkRouteListRemove(NWK_RouteTableEntry_t *entry)
+{
+  if (NWK_ROUTE_LIST_END == entry->prev)
+    nwkRouteListHead = entry->next;
+  else
+    nwkRouteTable[entry->prev].next = entry->next;
+
+  if (NWK_ROUTE_LIST_END == entry->next)
+    nwkRouteListTail = entry->prev;
+  else
+    nwkRouteTable[entry->next].prev = entry->prev;
+}
+
+/*************************************************************************//**
+  @brief Marks the @a entry as the most recently used one
+*****************************************************************************/
+static void nwkRouteTouch(NWK_RouteTableEntry_t *entry)
+{
+  if (nwkRouteListHead == entry - nwkRouteTable)
+    return;
+
+  nwkRouteListRemove(entry);
+  nwkRouteListInsert(entry, true);
 }
 
 /*************************************************************************//**
@@ -104,27 +197,23 @@ NWK_RouteTableEntry_t *NWK_RouteFindEntry(uint16_t dst, uint8_t multicast)
 *****************************************************************************/
 NWK_RouteTableEntry_t *NWK_RouteNewEntry(void)
 {
-  NWK_RouteTableEntry_t *iter = nwkRouteTable;
   NWK_RouteTableEntry_t *entry = NULL;
 
-  for (uint8_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++, iter++)
+  for (uint8_t i = nwkRouteListTail; NWK_ROUTE_LIST_END != i; i = nwkRouteTable[i].prev)
   {
-    if (iter->fixed)
-      continue;
-
-    if (0 == iter->rank)
+    if (0 == nwkRouteTable[i].fixed)
     {
-      entry = iter;
+      entry = &nwkRouteTable[i];
       break;
     }
-
-    if (NULL == entry || iter->rank < entry->rank)
-      entry = iter;
   }
 
+  if (NULL == entry)
+    return NULL;
+
   entry->multicast = 0;
   entry->score = NWK_ROUTE_DEFAULT_SCORE;
-  entry->rank = NWK_ROUTE_DEFAULT_RANK;
+  nwkRouteTouch(entry);
 
   return entry;
 }
@@ -136,7 +225,12 @@ void NWK_RouteFreeEntry(NWK_RouteTableEntry_t *entry)
   if (entry->fixed)
     return;
   entry->dstAddr = NWK_ROUTE_UNKNOWN;
-  entry->rank = 0;
+
+  if (nwkRouteListTail != entry - nwkRouteTable)
+  {
+    nwkRouteListRemove(entry);
+    nwkRouteListInsert(entry, false);
+  }
 }
 
 /*************************************************************************//**
@@ -167,15 +261,21 @@ void nwkRouteUpdateEntry(uint16_t dst, uint8_t multicast, uint16_t nextHop, uint
 
   entry = NWK_RouteFindEntry(dst, multicast);
 
+  if (entry && entry->fixed)
+    return;
+
   if (NULL == entry)
     entry = NWK_RouteNewEntry();
 
+  if (NULL == entry)
+    return;
+
   entry->dstAddr = dst;
   entry->nextHopAddr = nextHop;
   entry->multicast = multicast;
   entry->score = NWK_ROUTE_DEFAULT_SCORE;
-  entry->rank = NWK_ROUTE_DEFAULT_RANK;
   entry->lqi = lqi;
+  nwkRouteTouch(entry);
 }
 
 /*************************************************************************//**
@@ -204,8 +304,17 @@ void nwkRouteFrameReceived(NwkFrame_t *frame)
   if (NWK_BROADCAST_PANID == header->macDstPanId)
     return;
 
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+  // Routes towards the nodes sending route records are never used
+  if (header->nwkFcf.sourceRoute && nwkFrameSourceRouteHeader(frame)->record)
+    return;
+#endif
+
   entry = NWK_RouteFindEntry(header->nwkSrcAddr, false);
 
+  if (entry && entry->fixed)
+    return;
+
   if (entry)
   {
     bool discovery = (NWK_BROADCAST_ADDR == header->macDstAddr &&
@@ -221,6 +330,9 @@ void nwkRouteFrameReceived(NwkFrame_t *frame)
   {
     entry = NWK_RouteNewEntry();
 
+    if (NULL == entry)
+      return;
+
     entry->dstAddr = header->nwkSrcAddr;
     entry->nextHopAddr = header->macSrcAddr;
   }
@@ -231,6 +343,51 @@ void nwkRouteFrameReceived(NwkFrame_t *frame)
 #endif
 }
 
+#ifdef NWK_ENABLE_OVERHEARING
+/*************************************************************************//**
+  @brief Adds a route learned from an overheard frame if there is a free entry
+
+  Existing routes are never replaced or evicted by the overheard ones.
+*****************************************************************************/
+static void nwkRouteLearnEntry(uint16_t dst, uint8_t multicast, uint16_t nextHop, uint8_t lqi)
+{
+  if (nwkIb.addr == dst || NWK_RouteFindEntry(dst, multicast))
+    return;
+
+  for (uint8_t i = nwkRouteListTail; NWK_ROUTE_LIST_END != i; i = nwkRouteTable[i].prev)
+  {
+    if (nwkRouteTable[i].fixed)
+      continue;
+
+    if (NWK_ROUTE_UNKNOWN != nwkRouteTable[i].dstAddr)
+      return;
+
+    break;
+  }
+
+  nwkRouteUpdateEntry(dst, multicast, nextHop, lqi);
+}
+
+/*************************************************************************//**
+  @brief Learns routes from a unicast @a frame addressed to another node
+  @param[in] frame Pointer to the overheard frame
+*****************************************************************************/
+void nwkRouteFrameOverheard(NwkFrame_t *frame)
+{
+  NwkFrameHeader_t *header = &frame->header;
+  bool router = (0 == (header->macSrcAddr & NWK_ROUTE_NON_ROUTING));
+  uint8_t lqi = frame->rx.lqi;
+
+  nwkRouteLearnEntry(header->macSrcAddr, 0, header->macSrcAddr, lqi);
+
+  if (router || header->macSrcAddr == header->nwkSrcAddr)
+    nwkRouteLearnEntry(header->nwkSrcAddr, 0, header->macSrcAddr, lqi);
+
+  if (router)
+    nwkRouteLearnEntry(header->nwkDstAddr, header->nwkFcf.multicast, header->macSrcAddr, lqi);
+}
+#endif // NWK_ENABLE_OVERHEARING
+
 /*************************************************************************//**
 *****************************************************************************/
 void nwkRouteFrameSent(NwkFrame_t *frame)
@@ -240,6 +397,14 @@ void nwkRouteFrameSent(NwkFrame_t *frame)
   if (NWK_BROADCAST_ADDR == frame->header.nwkDstAddr)
     return;
 
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+  nwkSourceRouteFrameSent(frame);
+#endif
+
+#ifdef NWK_ENABLE_COLLECTION
+  nwkCollectionFrameSent(frame);
+#endif
+
   entry = NWK_RouteFindEntry(frame->header.nwkDstAddr, frame->header.nwkFcf.multicast);
 
   if (NULL == entry || entry->fixed)
@@ -248,9 +413,7 @@ void nwkRouteFrameSent(NwkFrame_t *frame)
   if (NWK_SUCCESS_STATUS == frame->tx.status)
   {
     entry->score = NWK_ROUTE_DEFAULT_SCORE;
-
-    if (NWK_ROUTE_MAX_RANK == ++entry->rank)
-      nwkRouteNormalizeRanks();
+    nwkRouteTouch(entry);
   }
   else
   {
@@ -285,6 +448,11 @@ void nwkRoutePrepareTx(NwkFrame_t *frame)
 
   else
   {
+  #ifdef NWK_ENABLE_SOURCE_ROUTING
+    if (nwkSourceRoutePrepareTx(frame))
+      return;
+  #endif
+
     header->macDstAddr = NWK_RouteNextHop(header->nwkDstAddr, header->nwkFcf.multicast);
 
   #ifdef NWK_ENABLE_ROUTE_DISCOVERY
@@ -300,6 +468,19 @@ void nwkRouteFrame(NwkFrame_t *frame)
 {
   NwkFrameHeader_t *header = &frame->header;
 
+#ifdef NWK_ENABLE_HOP_LIMIT
+  if (!nwkFrameDecrementHopLimit(frame))
+  {
+    nwkFrameFree(frame);
+    return;
+  }
+#endif
+
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+  if (nwkSourceRouteFrame(frame))
+    return;
+#endif
+
   if (NWK_ROUTE_UNKNOWN != NWK_RouteNextHop(header->nwkDstAddr, header->nwkFcf.multicast))
   {
     frame->tx.confirm = NULL;
@@ -308,24 +489,67 @@ void nwkRouteFrame(NwkFrame_t *frame)
   }
   else
   {
-    nwkRouteSendRouteError(header->nwkSrcAddr, header->nwkDstAddr, header->nwkFcf.multicast);
+    nwkRouteQueueRouteError(header->nwkSrcAddr, header->nwkDstAddr, header->nwkFcf.multicast);
     nwkFrameFree(frame);
   }
 }
 
 /*************************************************************************//**
+  @brief Schedules a route error for the (@a src, @a dst) pair
+
+  Errors for the pair are suppressed for NWK_ROUTE_ERROR_HOLD_DOWN after
+  the first one. Errors queued for the same source within one timer
+  interval are sent in a single command.
+*****************************************************************************/
+static void nwkRouteQueueRouteError(uint16_t src, uint16_t dst, uint8_t multicast)
+{
+  NwkRouteErrorEntry_t *entry;
+  NwkRouteErrorEntry_t *freeEntry = NULL;
+
+  for (uint8_t i = 0; i < NWK_ROUTE_ERROR_TABLE_SIZE; i++)
+  {
+    entry = &nwkRouteErrorTable[i];
+
+    if (0 == entry->holdDown && 0 == entry->pending)
+    {
+      freeEntry = entry;
+      continue;
+    }
+
+    if (entry->srcAddr == src && entry->dstAddr == dst && entry->multicast == multicast)
+      return;
+  }
+
+  if (NULL == freeEntry)
+    return;
+
+  freeEntry->srcAddr = src;
+  freeEntry->dstAddr = dst;
+  freeEntry->multicast = multicast;
+  freeEntry->pending = 1;
+  freeEntry->holdDown = ROUTE_ERROR_HOLD_DOWN;
+
+  SYS_TimerStart(&nwkRouteErrorTimer);
+}
+
+/*************************************************************************//**
+  @brief Sends pending route errors for the source @a src
+
+  With NWK_ENABLE_ROUTE_ERROR_AGGREGATION all pending destinations are sent
+  in one command. Otherwise each command carries a single destination, which
+  is the only format accepted by nodes without aggregation support.
 *****************************************************************************/
-static void nwkRouteSendRouteError(uint16_t src, uint16_t dst, uint8_t multicast)
+static void nwkRouteSendRouteError(uint16_t src)
 {
   NwkFrame_t *frame;
   NwkCommandRouteError_t *command;
+  uint8_t count = 0;
 
   if (NULL == (frame = nwkFrameAlloc()))
     return;
 
   nwkFrameCommandInit(frame);
 
-  frame->size += sizeof(NwkCommandRouteError_t);
   frame->tx.confirm = NULL;
 
   frame->header.nwkDstAddr = src;
@@ -333,32 +557,68 @@ static void nwkRouteSendRouteError(uint16_t src, uint16_t dst, uint8_t multicast
   command = (NwkCommandRouteError_t *)frame->payload;
   command->id = NWK_COMMAND_ROUTE_ERROR;
   command->srcAddr = src;
-  command->dstAddr = dst;
-  command->multicast = multicast;
+
+  for (uint8_t i = 0; i < NWK_ROUTE_ERROR_TABLE_SIZE; i++)
+  {
+    NwkRouteErrorEntry_t *entry = &nwkRouteErrorTable[i];
+
+    if (entry->pending && entry->srcAddr == src)
+    {
+      command->dst[count].dstAddr = entry->dstAddr;
+      command->dst[count].multicast = entry->multicast;
+      entry->pending = 0;
+      count++;
+    #ifndef NWK_ENABLE_ROUTE_ERROR_AGGREGATION
+      break;
+    #endif
+    }
+  }
+
+  frame->size += sizeof(NwkCommandRouteError_t) + count * sizeof(NwkCommandRouteErrorDst_t);
 
   nwkTxFrame(frame);
 }
 
 /*************************************************************************//**
 *****************************************************************************/
-bool nwkRouteErrorReceived(NWK_DataInd_t *ind)
+static void nwkRouteErrorTimerHandler(SYS_Timer_t *timer)
 {
-  NwkCommandRouteError_t *command = (NwkCommandRouteError_t *)ind->data;
+  bool restart = false;
 
-  if (sizeof(NwkCommandRouteError_t) != ind->size)
-    return false;
+  for (uint8_t i = 0; i < NWK_ROUTE_ERROR_TABLE_SIZE; i++)
+  {
+    if (nwkRouteErrorTable[i].pending)
+      nwkRouteSendRouteError(nwkRouteErrorTable[i].srcAddr);
+  }
 
-  nwkRouteRemove(command->dstAddr, command->multicast);
+  for (uint8_t i = 0; i < NWK_ROUTE_ERROR_TABLE_SIZE; i++)
+  {
+    if (nwkRouteErrorTable[i].holdDown)
+      nwkRouteErrorTable[i].holdDown--;
 
-  return true;
+    if (nwkRouteErrorTable[i].holdDown || nwkRouteErrorTable[i].pending)
+      restart = true;
+  }
+
+  if (restart)
+    SYS_TimerStart(timer);
 }
 
 /*************************************************************************//**
 *****************************************************************************/
-static void nwkRouteNormalizeRanks(void)
+bool nwkRouteErrorReceived(NWK_DataInd_t *ind)
 {
-  for (uint8_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
-    nwkRouteTable[i].rank = (nwkRouteTable[i].rank >> 1) + 1;
+  NwkCommandRouteError_t *command = (NwkCommandRouteError_t *)ind->data;
+  uint8_t size = ind->size - sizeof(NwkCommandRouteError_t);
+
+  if (ind->size < sizeof(NwkCommandRouteError_t) + sizeof(NwkCommandRouteErrorDst_t) ||
+      0 != size % sizeof(NwkCommandRouteErrorDst_t))
+    return false;
+
+  for (uint8_t i = 0; i < size / sizeof(NwkCommandRouteErrorDst_t); i++)
+    nwkRouteRemove(command->dst[i].dstAddr, command->dst[i].multicast);
+
+  return true;
 }
 
 #endif // NWK_ENABLE_ROUTING
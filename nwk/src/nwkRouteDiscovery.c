@@ -67,6 +67,7 @@
 #define NWK_ROUTE_DISCOVERY_BEST_LINK_QUALITY    255
 #define NWK_ROUTE_DISCOVERY_NO_LINK              0
 #define NWK_ROUTE_DISCOVERY_TIMER_INTERVAL       100 // ms
+#define NWK_ROUTE_DISCOVERY_NETWORK_RADIUS       0xff
 
 /*- Types ------------------------------------------------------------------*/
 enum
@@ -82,21 +83,44 @@ typedef struct NwkRouteDiscoveryTableEntry_t
   uint16_t   senderAddr;
   uint8_t    forwardLinkQuality;
   uint8_t    reverseLinkQuality;
+  uint8_t    radius;
   uint16_t   timeout;
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+  bool       forwarded;
+  uint8_t    requestSeq;
+#endif
 } NwkRouteDiscoveryTableEntry_t;
 
+typedef struct NwkRouteDiscoveryFailedEntry_t
+{
+  uint16_t   dstAddr;
+  uint8_t    multicast;
+  uint8_t    failures;
+  uint16_t   holdDown;
+} NwkRouteDiscoveryFailedEntry_t;
+
 /*- Prototypes -------------------------------------------------------------*/
 static NwkRouteDiscoveryTableEntry_t *nwkRouteDiscoveryFindEntry(uint16_t src,
     uint16_t dst, uint8_t multicast);
 static NwkRouteDiscoveryTableEntry_t *nwkRouteDiscoveryNewEntry(void);
 static void nwkRouteDiscoveryTimerHandler(SYS_Timer_t *timer);
-static bool nwkRouteDiscoverySendRequest(NwkRouteDiscoveryTableEntry_t *entry, uint8_t lq);
+static bool nwkRouteDiscoverySendRequest(NwkRouteDiscoveryTableEntry_t *entry, uint8_t lq,
+    uint8_t radius);
 static void nwkRouteDiscoverySendReply(NwkRouteDiscoveryTableEntry_t *entry, uint8_t flq, uint8_t rlq);
 static void nwkRouteDiscoveryDone(NwkRouteDiscoveryTableEntry_t *entry, bool status);
 static uint8_t nwkRouteDiscoveryUpdateLq(uint8_t lqa, uint8_t lqb);
+static uint8_t nwkRouteDiscoveryNextRadius(uint8_t radius);
+static uint16_t nwkRouteDiscoveryRingTimeout(uint8_t radius);
+static NwkRouteDiscoveryFailedEntry_t *nwkRouteDiscoveryFindFailed(uint16_t dst, uint8_t multicast);
+static void nwkRouteDiscoveryUpdateFailed(uint16_t dst, uint8_t multicast, bool status);
+static bool nwkRouteDiscoveryRateCheck(uint8_t *counter, uint8_t limit);
 
 /*- Variables --------------------------------------------------------------*/
 static NwkRouteDiscoveryTableEntry_t nwkRouteDiscoveryTable[NWK_ROUTE_DISCOVERY_TABLE_SIZE];
+static NwkRouteDiscoveryFailedEntry_t nwkRouteDiscoveryFailedTable[NWK_ROUTE_DISCOVERY_FAILED_TABLE_SIZE];
+static uint16_t nwkRouteDiscoveryRateWindow;
+static uint8_t nwkRouteDiscoveryOriginated;
+static uint8_t nwkRouteDiscoveryForwarded;
 static SYS_Timer_t nwkRouteDiscoveryTimer;
 
 /*- Implementations --------------------------------------------------------*/
@@ -109,6 +133,16 @@ void nwkRouteDiscoveryInit(void)
   for (uint8_t i = 0; i < NWK_ROUTE_DISCOVERY_TABLE_SIZE; i++)
     nwkRouteDiscoveryTable[i].timeout = 0;
 
+  for (uint8_t i = 0; i < NWK_ROUTE_DISCOVERY_FAILED_TABLE_SIZE; i++)
+  {
+    nwkRouteDiscoveryFailedTable[i].failures = 0;
+    nwkRouteDiscoveryFailedTable[i].holdDown = 0;
+  }
+
+  nwkRouteDiscoveryRateWindow = 0;
+  nwkRouteDiscoveryOriginated = 0;
+  nwkRouteDiscoveryForwarded = 0;
+
   nwkRouteDiscoveryTimer.interval = NWK_ROUTE_DISCOVERY_TIMER_INTERVAL;
   nwkRouteDiscoveryTimer.mode = SYS_TIMER_INTERVAL_MODE;
   nwkRouteDiscoveryTimer.handler = nwkRouteDiscoveryTimerHandler;
@@ -120,6 +154,7 @@ void nwkRouteDiscoveryRequest(NwkFrame_t *frame)
 {
   NwkFrameHeader_t *header = &frame->header;
   NwkRouteDiscoveryTableEntry_t *entry;
+  NwkRouteDiscoveryFailedEntry_t *failed;
   
   entry = nwkRouteDiscoveryFindEntry(nwkIb.addr, header->nwkDstAddr, header->nwkFcf.multicast);
 
@@ -129,22 +164,44 @@ void nwkRouteDiscoveryRequest(NwkFrame_t *frame)
     return;
   }
 
+  failed = nwkRouteDiscoveryFindFailed(header->nwkDstAddr, header->nwkFcf.multicast);
+
+  if (failed && failed->holdDown > 0)
+  {
+    nwkTxConfirm(frame, NWK_NO_ROUTE_STATUS);
+    return;
+  }
+
   entry = nwkRouteDiscoveryNewEntry();
 
-  if (entry)
+  if (NULL == entry)
   {
-    entry->srcAddr = nwkIb.addr;
-    entry->dstAddr = header->nwkDstAddr;
-    entry->multicast = header->nwkFcf.multicast;
-    entry->senderAddr = NWK_BROADCAST_ADDR;
+    nwkTxConfirm(frame, NWK_NO_ROUTE_STATUS);
+    return;
+  }
 
-    if (nwkRouteDiscoverySendRequest(entry, NWK_ROUTE_DISCOVERY_BEST_LINK_QUALITY))
-    {
-      frame->state = NWK_RD_STATE_WAIT_FOR_ROUTE;
-      return;
-    }
+  if (!nwkRouteDiscoveryRateCheck(&nwkRouteDiscoveryOriginated, NWK_ROUTE_DISCOVERY_MAX_ORIGINATED))
+  {
+    entry->timeout = 0;
+    nwkTxConfirm(frame, NWK_NO_ROUTE_STATUS);
+    return;
   }
 
+  entry->srcAddr = nwkIb.addr;
+  entry->dstAddr = header->nwkDstAddr;
+  entry->multicast = header->nwkFcf.multicast;
+  entry->senderAddr = NWK_BROADCAST_ADDR;
+  entry->radius = nwkRouteDiscoveryNextRadius(0);
+  entry->timeout = nwkRouteDiscoveryRingTimeout(entry->radius);
+
+  if (nwkRouteDiscoverySendRequest(entry, NWK_ROUTE_DISCOVERY_BEST_LINK_QUALITY,
+      entry->radius))
+  {
+    frame->state = NWK_RD_STATE_WAIT_FOR_ROUTE;
+    return;
+  }
+
+  nwkRouteDiscoveryOriginated--; // nothing was sent, return the token
   nwkTxConfirm(frame, NWK_NO_ROUTE_STATUS);
 }
 
@@ -184,7 +241,11 @@ static NwkRouteDiscoveryTableEntry_t *nwkRouteDiscoveryNewEntry(void)
   {
     entry->forwardLinkQuality = NWK_ROUTE_DISCOVERY_NO_LINK;
     entry->reverseLinkQuality = NWK_ROUTE_DISCOVERY_NO_LINK;
+    entry->radius = NWK_ROUTE_DISCOVERY_NETWORK_RADIUS;
     entry->timeout = NWK_ROUTE_DISCOVERY_TIMEOUT;
+  #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+    entry->forwarded = false;
+  #endif
     SYS_TimerStart(&nwkRouteDiscoveryTimer);
   }
 
@@ -207,22 +268,66 @@ static void nwkRouteDiscoveryTimerHandler(SYS_Timer_t *timer)
       entry->timeout -= NWK_ROUTE_DISCOVERY_TIMER_INTERVAL;
       restart = true;
     }
-    else
+    else if (entry->timeout > 0)
     {
       entry->timeout = 0;
 
-      if (entry->srcAddr == nwkIb.addr)
-        nwkRouteDiscoveryDone(entry, entry->reverseLinkQuality > 0);
+      if (entry->srcAddr != nwkIb.addr)
+        continue;
+
+      if (NWK_ROUTE_DISCOVERY_NO_LINK == entry->reverseLinkQuality &&
+          NWK_ROUTE_DISCOVERY_NETWORK_RADIUS != entry->radius)
+      {
+        entry->radius = nwkRouteDiscoveryNextRadius(entry->radius);
+        entry->timeout = nwkRouteDiscoveryRingTimeout(entry->radius);
+
+        if (nwkRouteDiscoverySendRequest(entry, NWK_ROUTE_DISCOVERY_BEST_LINK_QUALITY,
+            entry->radius))
+        {
+          restart = true;
+          continue;
+        }
+
+        entry->timeout = 0;
+      }
+
+      nwkRouteDiscoveryDone(entry, entry->reverseLinkQuality > 0);
     }
   }
 
+  for (uint8_t i = 0; i < NWK_ROUTE_DISCOVERY_FAILED_TABLE_SIZE; i++)
+  {
+    NwkRouteDiscoveryFailedEntry_t *failed = &nwkRouteDiscoveryFailedTable[i];
+
+    if (failed->holdDown > NWK_ROUTE_DISCOVERY_TIMER_INTERVAL)
+    {
+      failed->holdDown -= NWK_ROUTE_DISCOVERY_TIMER_INTERVAL;
+      restart = true;
+    }
+    else
+    {
+      failed->holdDown = 0;
+    }
+  }
+
+  if (nwkRouteDiscoveryRateWindow > NWK_ROUTE_DISCOVERY_TIMER_INTERVAL)
+  {
+    nwkRouteDiscoveryRateWindow -= NWK_ROUTE_DISCOVERY_TIMER_INTERVAL;
+    restart = true;
+  }
+  else
+  {
+    nwkRouteDiscoveryRateWindow = 0;
+  }
+
   if (restart)
     SYS_TimerStart(timer);
 }
 
 /*************************************************************************//**
 *****************************************************************************/
-static bool nwkRouteDiscoverySendRequest(NwkRouteDiscoveryTableEntry_t *entry, uint8_t lq)
+static bool nwkRouteDiscoverySendRequest(NwkRouteDiscoveryTableEntry_t *entry, uint8_t lq,
+    uint8_t radius)
 {
   NwkFrame_t *req;
   NwkCommandRouteRequest_t *command;
@@ -244,6 +349,12 @@ static bool nwkRouteDiscoverySendRequest(NwkRouteDiscoveryTableEntry_t *entry, u
   command->dstAddr = entry->dstAddr;
   command->multicast = entry->multicast;
   command->linkQuality = lq;
+  command->radius = radius;
+
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+  entry->forwarded = (entry->srcAddr != nwkIb.addr);
+  entry->requestSeq = req->header.nwkSeq;
+#endif
 
   nwkTxFrame(req);
 
@@ -282,29 +393,55 @@ bool nwkRouteDiscoveryRequestReceived(NWK_DataInd_t *ind)
 
   if (entry)
   {
-    if (linkQuality <= entry->forwardLinkQuality)
+    if (linkQuality <= entry->forwardLinkQuality && command->radius <= entry->radius)
+    {
+    #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+      // Copies of the request are sent with the forwarder's own source and
+      // sequence number, so they are matched against our pending copy here
+      if (entry->forwarded)
+        nwkTxBroadcastCopyHeard(nwkIb.addr, entry->requestSeq, ind->rssi);
+    #endif
       return true;
+    }
+
+    // A wider ring alone must not replace the best reverse path
+    if (linkQuality > entry->forwardLinkQuality)
+    {
+      entry->senderAddr = ind->srcAddr;
+      entry->forwardLinkQuality = linkQuality;
+    }
+
+    if (command->radius > entry->radius)
+      entry->radius = command->radius;
   }
   else
   {
     if (NULL == (entry = nwkRouteDiscoveryNewEntry()))
       return true;
-  }
 
-  entry->srcAddr = command->srcAddr;
-  entry->dstAddr = command->dstAddr;
-  entry->multicast = command->multicast;
-  entry->senderAddr = ind->srcAddr;
-  entry->forwardLinkQuality = linkQuality;
+    entry->srcAddr = command->srcAddr;
+    entry->dstAddr = command->dstAddr;
+    entry->multicast = command->multicast;
+    entry->senderAddr = ind->srcAddr;
+    entry->forwardLinkQuality = linkQuality;
+    entry->radius = command->radius;
+  }
 
   if (reply)
   {
-    nwkRouteUpdateEntry(command->srcAddr, 0, ind->srcAddr, linkQuality);
-    nwkRouteDiscoverySendReply(entry, linkQuality, NWK_ROUTE_DISCOVERY_BEST_LINK_QUALITY);
+    nwkRouteUpdateEntry(command->srcAddr, 0, entry->senderAddr, entry->forwardLinkQuality);
+    nwkRouteDiscoverySendReply(entry, entry->forwardLinkQuality, NWK_ROUTE_DISCOVERY_BEST_LINK_QUALITY);
   }
-  else
+  else if (entry->radius > 1 &&
+      nwkRouteDiscoveryRateCheck(&nwkRouteDiscoveryForwarded, NWK_ROUTE_DISCOVERY_MAX_FORWARDED))
   {
-    nwkRouteDiscoverySendRequest(entry, linkQuality);
+    uint8_t radius = entry->radius;
+
+    if (NWK_ROUTE_DISCOVERY_NETWORK_RADIUS != radius)
+      radius--;
+
+    if (!nwkRouteDiscoverySendRequest(entry, entry->forwardLinkQuality, radius))
+      nwkRouteDiscoveryForwarded--; // nothing was sent, return the token
   }
 
   return true;
@@ -380,6 +517,8 @@ static void nwkRouteDiscoveryDone(NwkRouteDiscoveryTableEntry_t *entry, bool sta
 {
   NwkFrame_t *frame = NULL;
 
+  nwkRouteDiscoveryUpdateFailed(entry->dstAddr, entry->multicast, status);
+
   while (NULL != (frame = nwkFrameNext(frame)))
   {
     if (NWK_RD_STATE_WAIT_FOR_ROUTE != frame->state)
@@ -403,4 +542,131 @@ static uint8_t nwkRouteDiscoveryUpdateLq(uint8_t lqa, uint8_t lqb)
   return ((uint16_t)lqa * lqb) >> 8;
 }
 
+/*************************************************************************//**
+  @brief Returns the radius of the next ring of the expanding ring search
+  @param[in] radius Radius of the current ring or 0 for the first ring
+  @return Radius of the next ring, the last ring covers the whole network
+*****************************************************************************/
+static uint8_t nwkRouteDiscoveryNextRadius(uint8_t radius)
+{
+  uint16_t next = radius ? (uint16_t)radius << 1 : 1;
+
+  if (next > NWK_ROUTE_DISCOVERY_RING_MAX_RADIUS)
+    return NWK_ROUTE_DISCOVERY_NETWORK_RADIUS;
+
+  return next;
+}
+
+/*************************************************************************//**
+  @brief Returns the time to wait for a reply from the ring of the given radius
+  @param[in] radius Radius of the ring
+  @return Timeout in milliseconds
+*****************************************************************************/
+static uint16_t nwkRouteDiscoveryRingTimeout(uint8_t radius)
+{
+  if (NWK_ROUTE_DISCOVERY_NETWORK_RADIUS == radius)
+    return NWK_ROUTE_DISCOVERY_TIMEOUT;
+
+  return (uint16_t)radius * 2 * NWK_ROUTE_DISCOVERY_RING_HOP_TIMEOUT +
+      NWK_ROUTE_DISCOVERY_TIMER_INTERVAL;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static NwkRouteDiscoveryFailedEntry_t *nwkRouteDiscoveryFindFailed(uint16_t dst, uint8_t multicast)
+{
+  for (uint8_t i = 0; i < NWK_ROUTE_DISCOVERY_FAILED_TABLE_SIZE; i++)
+  {
+    if (nwkRouteDiscoveryFailedTable[i].failures > 0 &&
+        nwkRouteDiscoveryFailedTable[i].dstAddr == dst &&
+        nwkRouteDiscoveryFailedTable[i].multicast == multicast)
+      return &nwkRouteDiscoveryFailedTable[i];
+  }
+
+  return NULL;
+}
+
+/*************************************************************************//**
+  @brief Records the result of the discovery for the destination @a dst
+  @param[in] dst Destination address
+  @param[in] multicast Destination is a multicast group
+  @param[in] status @c true if the route was found and @c false otherwise
+
+  Failed destinations are put on hold for NWK_ROUTE_DISCOVERY_HOLD_DOWN, the
+  hold-down period is doubled on each consecutive failure up to
+  NWK_ROUTE_DISCOVERY_MAX_HOLD_DOWN.
+*****************************************************************************/
+static void nwkRouteDiscoveryUpdateFailed(uint16_t dst, uint8_t multicast, bool status)
+{
+  NwkRouteDiscoveryFailedEntry_t *entry;
+  uint32_t holdDown;
+
+  entry = nwkRouteDiscoveryFindFailed(dst, multicast);
+
+  if (status)
+  {
+    if (entry)
+      entry->failures = 0;
+    return;
+  }
+
+  if (NULL == entry)
+  {
+    for (uint8_t i = 0; i < NWK_ROUTE_DISCOVERY_FAILED_TABLE_SIZE; i++)
+    {
+      NwkRouteDiscoveryFailedEntry_t *iter = &nwkRouteDiscoveryFailedTable[i];
+
+      if (0 == iter->failures)
+      {
+        entry = iter;
+        break;
+      }
+
+      if (NULL == entry || iter->holdDown < entry->holdDown)
+        entry = iter;
+    }
+
+    entry->dstAddr = dst;
+    entry->multicast = multicast;
+    entry->failures = 0;
+  }
+
+  if (entry->failures < 0xff)
+    entry->failures++;
+
+  holdDown = NWK_ROUTE_DISCOVERY_HOLD_DOWN;
+  for (uint8_t i = 1; i < entry->failures && holdDown < NWK_ROUTE_DISCOVERY_MAX_HOLD_DOWN; i++)
+    holdDown <<= 1;
+
+  if (holdDown > NWK_ROUTE_DISCOVERY_MAX_HOLD_DOWN)
+    holdDown = NWK_ROUTE_DISCOVERY_MAX_HOLD_DOWN;
+
+  entry->holdDown = holdDown;
+  SYS_TimerStart(&nwkRouteDiscoveryTimer);
+}
+
+/*************************************************************************//**
+  @brief Accounts for one more route request in the current rate window
+  @param[in] counter Pointer to the counter of requests in the current window
+  @param[in] limit Maximum number of requests per window
+  @return @c true if the request is allowed and @c false otherwise
+*****************************************************************************/
+static bool nwkRouteDiscoveryRateCheck(uint8_t *counter, uint8_t limit)
+{
+  if (0 == nwkRouteDiscoveryRateWindow)
+  {
+    nwkRouteDiscoveryRateWindow = NWK_ROUTE_DISCOVERY_RATE_WINDOW;
+    nwkRouteDiscoveryOriginated = 0;
+    nwkRouteDiscoveryForwarded = 0;
+    SYS_TimerStart(&nwkRouteDiscoveryTimer);
+  }
+
+  if (*counter >= limit)
+    return false;
+
+  (*counter)++;
+
+  return true;
+}
+
 #endif // NWK_ENABLE_ROUTE_DISCOVERY
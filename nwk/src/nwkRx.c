@@ -60,12 +60,14 @@
 #include "nwkCommand.h"
 #include "nwkSecurity.h"
 #include "nwkRouteDiscovery.h"
+#include "nwkCollection.h"
+#include "nwkSourceRoute.h"
+#include "nwkMulticastTrickle.h"
 
 /*- Definitions ------------------------------------------------------------*/
 #define NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL   100 // ms
 #define DUPLICATE_REJECTION_TTL \
             ((NWK_DUPLICATE_REJECTION_TTL / NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL) + 1)
-#define NWK_SERVICE_ENDPOINT_ID    0
 
 /*- Types ------------------------------------------------------------------*/
 enum
@@ -83,6 +85,9 @@ typedef struct NwkDuplicateRejectionEntry_t
   uint8_t  seq;
   uint8_t  mask;
   uint8_t  ttl;
+#ifdef NWK_ENABLE_HOP_LIMIT
+  uint8_t  hopLimit;
+#endif
 } NwkDuplicateRejectionEntry_t;
 
 /*- Prototypes -------------------------------------------------------------*/
@@ -195,12 +200,43 @@ static void nwkRxDuplicateRejectionTimerHandler(SYS_Timer_t *timer)
     SYS_TimerStart(timer);
 }
 
+/*************************************************************************//**
+  @brief Checks if the frame is a routing loop rather than a duplicate
+  @param[in] entry Duplicate rejection entry for the frame source
+  @param[in] diff Distance between the frame and the latest sequence number
+  @param[in] frame Received copy of the frame
+
+  Copies of the frame with the same hop limit are retransmissions or
+  multi-path duplicates. Only the copy that travelled more hops than
+  the one already seen indicates a loop. Hop limit is stored only for
+  the latest sequence number.
+*****************************************************************************/
+static bool nwkRxIsLoop(NwkDuplicateRejectionEntry_t *entry, uint8_t diff, NwkFrame_t *frame)
+{
+#ifdef NWK_ENABLE_HOP_LIMIT
+  if (frame->header.nwkFcf.hopLimit && entry->hopLimit)
+    return 0 == diff && *nwkFrameHopLimit(frame) < entry->hopLimit;
+#else
+  (void)entry;
+  (void)diff;
+  (void)frame;
+#endif
+  return true;
+}
+
 /*************************************************************************//**
 *****************************************************************************/
-static bool nwkRxRejectDuplicate(NwkFrameHeader_t *header)
+static bool nwkRxRejectDuplicate(NwkFrame_t *frame)
 {
+  NwkFrameHeader_t *header = &frame->header;
   NwkDuplicateRejectionEntry_t *entry;
   NwkDuplicateRejectionEntry_t *freeEntry = NULL;
+#ifdef NWK_ENABLE_HOP_LIMIT
+  uint8_t hopLimit = 0;
+
+  if (header->nwkFcf.hopLimit)
+    hopLimit = *nwkFrameHopLimit(frame);
+#endif
 
   for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
   {
@@ -215,7 +251,7 @@ static bool nwkRxRejectDuplicate(NwkFrameHeader_t *header)
         if (entry->mask & (1 << diff))
         {
         #ifdef NWK_ENABLE_ROUTING
-          if (nwkIb.addr == header->macDstAddr)
+          if (nwkIb.addr == header->macDstAddr && nwkRxIsLoop(entry, diff, frame))
             nwkRouteRemove(header->nwkDstAddr, header->nwkFcf.multicast);
         #endif
           return true;
@@ -231,6 +267,9 @@ static bool nwkRxRejectDuplicate(NwkFrameHeader_t *header)
         entry->seq = header->nwkSeq;
         entry->mask = (entry->mask << shift) | 1;
         entry->ttl = DUPLICATE_REJECTION_TTL;
+      #ifdef NWK_ENABLE_HOP_LIMIT
+        entry->hopLimit = hopLimit;
+      #endif
         return false;
       }
     }
@@ -246,6 +285,9 @@ static bool nwkRxRejectDuplicate(NwkFrameHeader_t *header)
   freeEntry->seq = header->nwkSeq;
   freeEntry->mask = 1;
   freeEntry->ttl = DUPLICATE_REJECTION_TTL;
+#ifdef NWK_ENABLE_HOP_LIMIT
+  freeEntry->hopLimit = hopLimit;
+#endif
 
   SYS_TimerStart(&nwkRxDuplicateRejectionTimer);
 
@@ -282,11 +324,43 @@ static bool nwkRxServiceDataInd(NWK_DataInd_t *ind)
       return nwkRouteDiscoveryReplyReceived(ind);
 #endif
 
+#ifdef NWK_ENABLE_COLLECTION
+    case NWK_COMMAND_COLLECTION_ADVERTISEMENT:
+      return nwkCollectionAdvertisementReceived(ind);
+#endif
+
+#ifdef NWK_ENABLE_GROUP_COMMANDS
+    case NWK_COMMAND_GROUP_ADD:
+    case NWK_COMMAND_GROUP_REMOVE:
+      return nwkGroupCommandReceived(ind);
+#endif
+
     default:
       return false;
   }
 }
 
+/*************************************************************************//**
+  @brief Rebroadcasts a received broadcast or multicast @a frame
+*****************************************************************************/
+static void nwkRxBroadcastFrame(NwkFrame_t *frame)
+{
+#ifdef NWK_ENABLE_HOP_LIMIT
+  if (!nwkFrameDecrementHopLimit(frame))
+    return;
+#endif
+
+#ifdef NWK_ENABLE_MULTICAST_TRICKLE
+  if (frame->header.nwkFcf.multicast)
+  {
+    nwkMulticastTrickleFrame(frame);
+    return;
+  }
+#endif
+
+  nwkTxBroadcastFrame(frame);
+}
+
 /*************************************************************************//**
 *****************************************************************************/
 static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
@@ -308,6 +382,51 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
     return;
 #endif
 
+#ifdef NWK_ENABLE_HOP_LIMIT
+  if (header->nwkFcf.hopLimit)
+  {
+    if (frame->size <= sizeof(NwkFrameHeader_t))
+      return;
+    frame->payload++;
+  }
+#else
+  if (header->nwkFcf.hopLimit)
+    return;
+#endif
+
+#ifdef NWK_ENABLE_KEY_TABLE
+  if (header->nwkFcf.keyIndex)
+  {
+    if (!header->nwkFcf.security || frame->size <= (frame->payload - frame->data))
+      return;
+    frame->payload++;
+  }
+#else
+  if (header->nwkFcf.keyIndex)
+    return;
+#endif
+
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  if (header->nwkFcf.frameCounter)
+  {
+    if (!header->nwkFcf.security ||
+        frame->size < (frame->payload - frame->data) + sizeof(uint32_t))
+      return;
+    frame->payload += sizeof(uint32_t);
+  }
+#else
+  if (header->nwkFcf.frameCounter)
+    return;
+#endif
+
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+  if (!nwkSourceRouteFrameReceived(frame))
+    return;
+#else
+  if (header->nwkFcf.sourceRoute)
+    return;
+#endif
+
   if (NWK_BROADCAST_PANID == header->macDstPanId)
   {
     if (nwkIb.addr == header->nwkDstAddr || NWK_BROADCAST_ADDR == header->nwkDstAddr)
@@ -333,12 +452,34 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
   if (nwkIb.addr == header->nwkSrcAddr)
     return;
 
+#ifdef NWK_ENABLE_OVERHEARING
+  // Address filtering is done here since the transceiver is in promiscuous mode
+  if (nwkIb.panId != header->macDstPanId)
+    return;
+
+  if (nwkIb.addr != header->macDstAddr && NWK_BROADCAST_ADDR != header->macDstAddr)
+  {
+    nwkRouteFrameOverheard(frame);
+    return;
+  }
+#endif
+
 #ifdef NWK_ENABLE_ROUTING
   nwkRouteFrameReceived(frame);
 #endif
 
-  if (nwkRxRejectDuplicate(header))
+  if (nwkRxRejectDuplicate(frame))
+  {
+  #ifdef NWK_ENABLE_MULTICAST_TRICKLE
+    if (header->nwkFcf.multicast && NWK_BROADCAST_ADDR == header->macDstAddr)
+      nwkMulticastTrickleHeard(frame);
+  #endif
+  #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+    if (NWK_BROADCAST_ADDR == header->macDstAddr)
+      nwkTxBroadcastHeard(frame);
+  #endif
     return;
+  }
 
 #ifdef NWK_ENABLE_MULTICAST
   if (header->nwkFcf.multicast)
@@ -378,7 +519,7 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
     }
 
     if (broadcast)
-      nwkTxBroadcastFrame(frame);
+      nwkRxBroadcastFrame(frame);
 
     if (member)
     {
@@ -397,7 +538,7 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
   {
     if (NWK_BROADCAST_ADDR == header->macDstAddr && nwkIb.addr != header->nwkDstAddr &&
         0 == header->nwkFcf.linkLocal)
-      nwkTxBroadcastFrame(frame);
+      nwkRxBroadcastFrame(frame);
 
     if (nwkIb.addr == header->nwkDstAddr || NWK_BROADCAST_ADDR == header->nwkDstAddr)
     {
@@ -58,23 +58,78 @@
 
 #ifdef NWK_ENABLE_SECURITY
 
+/*- Definitions ------------------------------------------------------------*/
+#if NWK_SECURITY_MODE != 0
+#define NWK_SECURITY_CCM_FLAGS_B0    ((1 << 6) | (((NWK_SECURITY_MIC_SIZE - 2) / 2) << 3) | (2 - 1))
+#define NWK_SECURITY_CCM_FLAGS_A     (2 - 1)
+#define NWK_SECURITY_CCM_LEVEL       5 // ENC-MIC-32
+#define NWK_SECURITY_CCM_AUTH_SIZE   7 // nwkFcf ... endpoints
+#define NWK_SECURITY_STREAM_SIZE     (NWK_SECURITY_CCM_BURST * NWK_SECURITY_BLOCK_SIZE)
+#endif
+
 /*- Types ------------------------------------------------------------------*/
 enum
 {
   NWK_SECURITY_STATE_ENCRYPT_PENDING = 0x30,
   NWK_SECURITY_STATE_DECRYPT_PENDING = 0x31,
   NWK_SECURITY_STATE_PROCESS         = 0x32,
-  NWK_SECURITY_STATE_WAIT            = 0x33,
-  NWK_SECURITY_STATE_CONFIRM         = 0x34,
 };
 
+typedef struct NwkSecurityContext_t
+{
+  uint32_t   vector[4];
+  NwkFrame_t *frame;
+  uint8_t    *key;
+  uint8_t    size;
+  uint8_t    offset;
+  bool       encrypt;
+  bool       done;
+#if NWK_SECURITY_MODE != 0
+  uint8_t    stream[NWK_SECURITY_STREAM_SIZE];
+  uint8_t    counter;
+  uint8_t    blocks;
+  uint8_t    block;
+  bool       ready;
+#endif
+#if NWK_SECURITY_MODE == 1
+  uint8_t    mask[NWK_SECURITY_MIC_SIZE];
+  bool       burst;
+#elif NWK_SECURITY_MODE == 2
+  bool       mac;
+  bool       valid;
+#endif
+} NwkSecurityContext_t;
+
+#ifdef NWK_ENABLE_FRAME_COUNTER
+typedef struct NwkSecurityCounterEntry_t
+{
+  uint16_t   addr;
+  uint32_t   counter;
+} NwkSecurityCounterEntry_t;
+#endif
+
+#ifdef NWK_ENABLE_KEY_TABLE
+typedef struct NwkSecurityKeyEntry_t
+{
+  uint32_t   key[SYS_ENCRYPT_KEY_SIZE / 4];
+  uint16_t   addr;
+  uint8_t    type;
+} NwkSecurityKeyEntry_t;
+#endif
+
 /*- Variables --------------------------------------------------------------*/
 static uint8_t nwkSecurityActiveFrames;
-static NwkFrame_t *nwkSecurityActiveFrame;
-static uint8_t nwkSecuritySize;
-static uint8_t nwkSecurityOffset;
-static bool nwkSecurityEncrypt;
-static uint32_t nwkSecurityVector[4];
+static NwkSecurityContext_t nwkSecurityContexts[NWK_SECURITY_CONTEXTS];
+static NwkSecurityContext_t *nwkSecurityActiveContext;
+#ifdef NWK_ENABLE_KEY_TABLE
+static NwkSecurityKeyEntry_t nwkSecurityKeys[NWK_KEY_TABLE_SIZE];
+#endif
+#ifdef NWK_ENABLE_FRAME_COUNTER
+static NwkSecurityCounterEntry_t nwkSecurityCounters[NWK_FRAME_COUNTER_TABLE_SIZE];
+static uint8_t nwkSecurityCountersSize;
+static uint32_t nwkSecurityCheckpoint;
+static void (*nwkSecurityCheckpointHandler)(uint32_t counter);
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -84,16 +139,144 @@ static uint32_t nwkSecurityVector[4];
 void nwkSecurityInit(void)
 {
   nwkSecurityActiveFrames = 0;
-  nwkSecurityActiveFrame = NULL;
+  nwkSecurityActiveContext = NULL;
+  nwkIb.securityRejects = 0;
+
+  for (uint8_t i = 0; i < NWK_SECURITY_CONTEXTS; i++)
+    nwkSecurityContexts[i].frame = NULL;
+
+#ifdef NWK_ENABLE_KEY_TABLE
+  for (uint8_t i = 0; i < NWK_KEY_TABLE_SIZE; i++)
+    nwkSecurityKeys[i].type = NWK_KEY_TYPE_NONE;
+#endif
+
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  nwkIb.frameCounter = 0;
+  nwkSecurityCheckpoint = 0;
+  nwkSecurityCheckpointHandler = NULL;
+  nwkSecurityCountersSize = 0;
+#endif
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 void NWK_SetSecurityKey(uint8_t *key)
 {
-  memcpy((uint8_t *)nwkIb.key, key, NWK_SECURITY_KEY_SIZE);
+  SYS_EncryptPrepareKey((uint8_t *)nwkIb.key, key);
+}
+
+#ifdef NWK_ENABLE_KEY_TABLE
+/*************************************************************************//**
+*****************************************************************************/
+static bool nwkSecuritySetKey(uint8_t id, uint8_t type, uint16_t addr, uint8_t *key)
+{
+  NwkSecurityKeyEntry_t *entry;
+
+  if (0 == id || id > NWK_KEY_TABLE_SIZE)
+    return false;
+
+  entry = &nwkSecurityKeys[id - 1];
+  SYS_EncryptPrepareKey((uint8_t *)entry->key, key);
+  entry->addr = addr;
+  entry->type = type;
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Installs a pairwise key shared with the node @a addr
+
+  Key IDs are carried in secured frames, so both nodes must install the
+  key under the same @a id (1 ... NWK_KEY_TABLE_SIZE). The key schedule is
+  prepared once here, so selecting a key costs nothing per frame.
+*****************************************************************************/
+bool NWK_SetLinkKey(uint8_t id, uint16_t addr, uint8_t *key)
+{
+  return nwkSecuritySetKey(id, NWK_KEY_TYPE_LINK, addr, key);
+}
+
+/*************************************************************************//**
+  @brief Installs a key used for multicast frames sent to the @a group
+*****************************************************************************/
+bool NWK_SetGroupKey(uint8_t id, uint16_t group, uint8_t *key)
+{
+  return nwkSecuritySetKey(id, NWK_KEY_TYPE_GROUP, group, key);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void NWK_RemoveKey(uint8_t id)
+{
+  if (id && id <= NWK_KEY_TABLE_SIZE)
+    nwkSecurityKeys[id - 1].type = NWK_KEY_TYPE_NONE;
+}
+
+/*************************************************************************//**
+  @brief Selects a key for the outgoing secured @a frame
+
+  A group key is used for multicast frames and a link key for unicast
+  frames if one is installed for @a dstAddr. The key ID is then added to
+  the frame as a one byte header extension. Frames without the extension
+  are protected with the network key.
+*****************************************************************************/
+void nwkSecurityKeyIndexInit(NwkFrame_t *frame, uint16_t dstAddr, bool multicast)
+{
+  uint8_t type = multicast ? NWK_KEY_TYPE_GROUP : NWK_KEY_TYPE_LINK;
+
+  for (uint8_t i = 0; i < NWK_KEY_TABLE_SIZE; i++)
+  {
+    if (type == nwkSecurityKeys[i].type && dstAddr == nwkSecurityKeys[i].addr)
+    {
+      frame->header.nwkFcf.keyIndex = 1;
+      *nwkFrameKeyIndex(frame) = i + 1;
+      frame->payload++;
+      frame->size++;
+      return;
+    }
+  }
 }
 
+/*************************************************************************//**
+  @brief Finds the key for the @a frame using the key ID in its header
+  @return Prepared key or NULL if the key ID is not valid for the frame
+*****************************************************************************/
+static uint8_t *nwkSecurityFrameKey(NwkFrame_t *frame)
+{
+  NwkFrameHeader_t *header = &frame->header;
+  NwkSecurityKeyEntry_t *entry;
+  uint8_t id;
+
+  if (0 == header->nwkFcf.keyIndex)
+    return (uint8_t *)nwkIb.key;
+
+  id = *nwkFrameKeyIndex(frame);
+
+  if (0 == id || id > NWK_KEY_TABLE_SIZE)
+    return NULL;
+
+  entry = &nwkSecurityKeys[id - 1];
+
+  if (NWK_KEY_TYPE_GROUP == entry->type)
+  {
+    if (!header->nwkFcf.multicast || entry->addr != header->nwkDstAddr)
+      return NULL;
+  }
+  else if (NWK_KEY_TYPE_LINK == entry->type)
+  {
+    uint16_t peer = (nwkIb.addr == header->nwkSrcAddr) ? header->nwkDstAddr : header->nwkSrcAddr;
+
+    if (header->nwkFcf.multicast || entry->addr != peer)
+      return NULL;
+  }
+  else
+  {
+    return NULL;
+  }
+
+  return (uint8_t *)entry->key;
+}
+#endif
+
 /*************************************************************************//**
 *****************************************************************************/
 void nwkSecurityProcess(NwkFrame_t *frame, bool encrypt)
@@ -105,69 +288,194 @@ void nwkSecurityProcess(NwkFrame_t *frame, bool encrypt)
   ++nwkSecurityActiveFrames;
 }
 
+#ifdef NWK_ENABLE_FRAME_COUNTER
 /*************************************************************************//**
+  @brief Restores the outgoing frame counter, normally from a checkpoint
 *****************************************************************************/
-static void nwkSecurityStart(void)
+void NWK_SetFrameCounter(uint32_t counter)
 {
-  NwkFrameHeader_t *header = &nwkSecurityActiveFrame->header;
+  nwkIb.frameCounter = counter;
+  nwkSecurityCheckpoint = counter;
+}
 
-  nwkSecurityVector[0] = header->nwkSeq;
-  nwkSecurityVector[1] = ((uint32_t)header->nwkDstAddr << 16) | header->nwkDstEndpoint;
-  nwkSecurityVector[2] = ((uint32_t)header->nwkSrcAddr << 16) | header->nwkSrcEndpoint;
-  nwkSecurityVector[3] = ((uint32_t)header->macDstPanId << 16) | *(uint8_t *)&header->nwkFcf;
+/*************************************************************************//**
+  @brief Sets a @a handler that persists the outgoing frame counter
 
-  if (NWK_SECURITY_STATE_DECRYPT_PENDING == nwkSecurityActiveFrame->state)
-    nwkSecurityActiveFrame->size -= NWK_SECURITY_MIC_SIZE;
+  The handler is called before the first secured frame is sent and then
+  every NWK_FRAME_COUNTER_GAP frames. It receives a value that is larger
+  than any counter that will be used before the next call. That value must
+  be stored in non-volatile memory before the handler returns and passed to
+  NWK_SetFrameCounter() after a reset.
+*****************************************************************************/
+void NWK_SetFrameCounterHandler(void (*handler)(uint32_t counter))
+{
+  nwkSecurityCheckpointHandler = handler;
+}
 
-  nwkSecuritySize = nwkFramePayloadSize(nwkSecurityActiveFrame);
-  nwkSecurityOffset = 0;
-  nwkSecurityEncrypt = (NWK_SECURITY_STATE_ENCRYPT_PENDING == nwkSecurityActiveFrame->state);
+/*************************************************************************//**
+  @brief Inserts the outgoing frame counter into the @a frame before the
+    source route header
+
+  @return @c false if there is no room left for the counter
+*****************************************************************************/
+static bool nwkSecurityFrameCounterInsert(NwkFrame_t *frame)
+{
+  uint8_t *counter = nwkFrameFrameCounter(frame);
 
-  nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_PROCESS;
+  if (frame->size + sizeof(uint32_t) + NWK_SECURITY_MIC_SIZE > NWK_FRAME_MAX_PAYLOAD_SIZE - 2/*crc*/)
+    return false;
+
+  if (nwkIb.frameCounter == nwkSecurityCheckpoint)
+  {
+    nwkSecurityCheckpoint += NWK_FRAME_COUNTER_GAP;
+    if (nwkSecurityCheckpointHandler)
+      nwkSecurityCheckpointHandler(nwkSecurityCheckpoint);
+  }
+
+  memmove(counter + sizeof(uint32_t), counter, frame->size - (counter - frame->data));
+  memcpy(counter, (uint8_t *)&nwkIb.frameCounter, sizeof(uint32_t));
+  frame->header.nwkFcf.frameCounter = 1;
+  frame->payload += sizeof(uint32_t);
+  frame->size += sizeof(uint32_t);
+
+  nwkIb.frameCounter++;
+
+  return true;
 }
 
 /*************************************************************************//**
+  @brief Returns the frame counter of the received @a frame
 *****************************************************************************/
-void SYS_EncryptConf(void)
+static uint32_t nwkSecurityFrameCounter(NwkFrame_t *frame)
 {
-  uint8_t *vector = (uint8_t *)nwkSecurityVector;
-  uint8_t *text = &nwkSecurityActiveFrame->payload[nwkSecurityOffset];
+  uint32_t counter;
+
+  memcpy((uint8_t *)&counter, nwkFrameFrameCounter(frame), sizeof(uint32_t));
+  return counter;
+}
+
+/*************************************************************************//**
+  @brief Finds the highest frame counter seen from @a addr
+  @return Table index or nwkSecurityCountersSize if the source is unknown
+*****************************************************************************/
+static uint8_t nwkSecurityCounterFind(uint16_t addr)
+{
+  uint8_t i;
+
+  for (i = 0; i < nwkSecurityCountersSize; i++)
+  {
+    if (nwkSecurityCounters[i].addr == addr)
+      break;
+  }
+
+  return i;
+}
+
+/*************************************************************************//**
+  @brief Checks the received @a frame for a replayed frame counter
+
+  This runs before decryption, so replayed frames cost no cipher time.
+  Sources that were evicted from the table are accepted again, and the
+  duplicate rejection table remains the only protection for them.
+*****************************************************************************/
+static bool nwkSecurityFrameCounterCheck(NwkFrame_t *frame)
+{
+  uint8_t i;
+
+  if (0 == frame->header.nwkFcf.frameCounter)
+    return false;
+
+  i = nwkSecurityCounterFind(frame->header.nwkSrcAddr);
+
+  return i == nwkSecurityCountersSize ||
+      nwkSecurityFrameCounter(frame) > nwkSecurityCounters[i].counter;
+}
+
+/*************************************************************************//**
+  @brief Records the frame counter of the authenticated @a frame
+
+  The table is kept in most recently used order, so the least recently
+  heard source is evicted when the table is full.
+*****************************************************************************/
+static void nwkSecurityFrameCounterAccept(NwkFrame_t *frame)
+{
+  uint8_t i = nwkSecurityCounterFind(frame->header.nwkSrcAddr);
+
+  if (i == nwkSecurityCountersSize)
+  {
+    if (nwkSecurityCountersSize < NWK_FRAME_COUNTER_TABLE_SIZE)
+      nwkSecurityCountersSize++;
+    i = nwkSecurityCountersSize - 1;
+  }
+
+  memmove(&nwkSecurityCounters[1], &nwkSecurityCounters[0], i * sizeof(NwkSecurityCounterEntry_t));
+  nwkSecurityCounters[0].addr = frame->header.nwkSrcAddr;
+  nwkSecurityCounters[0].counter = nwkSecurityFrameCounter(frame);
+}
+#endif
+
+#if NWK_SECURITY_MODE == 0
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSecurityStartFrame(NwkSecurityContext_t *ctx)
+{
+  NwkFrameHeader_t *header = &ctx->frame->header;
+
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  if (header->nwkFcf.frameCounter)
+    ctx->vector[0] = nwkSecurityFrameCounter(ctx->frame);
+  else
+#endif
+    ctx->vector[0] = header->nwkSeq;
+  ctx->vector[1] = ((uint32_t)header->nwkDstAddr << 16) | header->nwkDstEndpoint;
+  ctx->vector[2] = ((uint32_t)header->nwkSrcAddr << 16) | header->nwkSrcEndpoint;
+  ctx->vector[3] = ((uint32_t)header->macDstPanId << 16) | *(uint8_t *)&header->nwkFcf;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSecurityRequest(NwkSecurityContext_t *ctx)
+{
+  SYS_EncryptReq((uint8_t *)ctx->vector, ctx->key);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSecurityConfirm(NwkSecurityContext_t *ctx)
+{
+  uint8_t *vector = (uint8_t *)ctx->vector;
+  uint8_t *text = &ctx->frame->payload[ctx->offset];
   uint8_t block;
 
-  block = (nwkSecuritySize < NWK_SECURITY_BLOCK_SIZE) ? nwkSecuritySize : NWK_SECURITY_BLOCK_SIZE;
+  block = (ctx->size < NWK_SECURITY_BLOCK_SIZE) ? ctx->size : NWK_SECURITY_BLOCK_SIZE;
 
   for (uint8_t i = 0; i < block; i++)
   {
     text[i] ^= vector[i];
 
-    if (nwkSecurityEncrypt)
+    if (ctx->encrypt)
       vector[i] = text[i];
     else
       vector[i] ^= text[i];
   }
 
-  nwkSecurityOffset += block;
-  nwkSecuritySize -= block;
-
-  if (nwkSecuritySize > 0)
-    nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_PROCESS;
-  else
-    nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_CONFIRM;
+  ctx->offset += block;
+  ctx->size -= block;
+  ctx->done = (0 == ctx->size);
 }
 
 /*************************************************************************//**
 *****************************************************************************/
-static bool nwkSecurityProcessMic(void)
+static bool nwkSecurityProcessMic(NwkSecurityContext_t *ctx)
 {
-  uint8_t *mic = &nwkSecurityActiveFrame->payload[nwkSecurityOffset];
-  uint32_t vmic = nwkSecurityVector[0] ^ nwkSecurityVector[1] ^
-                  nwkSecurityVector[2] ^ nwkSecurityVector[3];
+  uint8_t *mic = &ctx->frame->payload[ctx->offset];
+  uint32_t vmic = ctx->vector[0] ^ ctx->vector[1] ^ ctx->vector[2] ^ ctx->vector[3];
   uint32_t tmic;
 
-  if (nwkSecurityEncrypt)
+  if (ctx->encrypt)
   {
     memcpy(mic, (uint8_t *)&vmic, NWK_SECURITY_MIC_SIZE);
-    nwkSecurityActiveFrame->size += NWK_SECURITY_MIC_SIZE;
+    ctx->frame->size += NWK_SECURITY_MIC_SIZE;
     return true;
   }
   else
@@ -177,49 +485,428 @@ static bool nwkSecurityProcessMic(void)
   }
 }
 
+#else
 /*************************************************************************//**
-  @brief Security Module task handler
+  @brief Fills @a block with the CCM* flags, nonce and a 16-bit @a value
+
+  The nonce is built from the source address, PAN ID, frame counter and
+  sequence number. Sequence number alone repeats every 256 frames, so these
+  modes require NWK_ENABLE_FRAME_COUNTER (see sysConfig.h).
 *****************************************************************************/
-void nwkSecurityTaskHandler(void)
+static void nwkSecurityCcmBlock(NwkSecurityContext_t *ctx, uint8_t *block,
+    uint8_t flags, uint16_t value)
 {
-  NwkFrame_t *frame = NULL;
+  NwkFrameHeader_t *header = &ctx->frame->header;
+
+  memset(block, 0, NWK_SECURITY_BLOCK_SIZE);
+  block[0] = flags;
+  block[1] = header->nwkSrcAddr & 0xff;
+  block[2] = header->nwkSrcAddr >> 8;
+  block[3] = header->macDstPanId & 0xff;
+  block[4] = header->macDstPanId >> 8;
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  if (header->nwkFcf.frameCounter)
+  {
+    uint32_t counter = nwkSecurityFrameCounter(ctx->frame);
+
+    block[5] = counter >> 24;
+    block[6] = counter >> 16;
+    block[7] = counter >> 8;
+    block[8] = counter;
+  }
+#endif
+  block[9] = header->nwkSeq;
+  block[13] = NWK_SECURITY_CCM_LEVEL;
+  block[14] = value >> 8;
+  block[15] = value & 0xff;
+}
+
+/*************************************************************************//**
+  @brief Adds the NWK header as authenticated data to the CBC-MAC @a vector
+*****************************************************************************/
+static void nwkSecurityMacHeader(NwkSecurityContext_t *ctx, uint8_t *vector)
+{
+  uint8_t *auth = (uint8_t *)&ctx->frame->header.nwkFcf;
+
+  vector[1] ^= NWK_SECURITY_CCM_AUTH_SIZE;
+  for (uint8_t i = 0; i < NWK_SECURITY_CCM_AUTH_SIZE; i++)
+    vector[i + 2] ^= auth[i];
+}
+
+#if NWK_SECURITY_MODE == 1
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSecurityStartFrame(NwkSecurityContext_t *ctx)
+{
+  nwkSecurityCcmBlock(ctx, (uint8_t *)ctx->vector, NWK_SECURITY_CCM_FLAGS_B0, ctx->size);
+  ctx->counter = 0;
+  ctx->blocks = 0;
+  ctx->block = 0;
+  ctx->ready = true;
+}
+
+/*************************************************************************//**
+  @brief Issues the next cipher request for the context @a ctx
+
+  Key stream blocks depend only on the nonce, so they are generated in
+  bursts of NWK_SECURITY_CCM_BURST blocks ahead of the CBC-MAC chain. Each
+  payload block is passed through the CBC-MAC and the key stream as soon as
+  its key stream block is available.
+*****************************************************************************/
+static void nwkSecurityRequest(NwkSecurityContext_t *ctx)
+{
+  uint8_t *vector = (uint8_t *)ctx->vector;
+
+  if (0 == ctx->blocks || (!ctx->ready && ctx->block >= ctx->counter + ctx->blocks))
+  {
+    uint8_t last = (ctx->size + NWK_SECURITY_BLOCK_SIZE - 1) / NWK_SECURITY_BLOCK_SIZE;
 
-  if (0 == nwkSecurityActiveFrames)
+    ctx->counter += ctx->blocks;
+    ctx->blocks = last + 1 - ctx->counter;
+    if (ctx->blocks > NWK_SECURITY_CCM_BURST)
+      ctx->blocks = NWK_SECURITY_CCM_BURST;
+
+    for (uint8_t i = 0; i < ctx->blocks; i++)
+      nwkSecurityCcmBlock(ctx, &ctx->stream[i * NWK_SECURITY_BLOCK_SIZE],
+          NWK_SECURITY_CCM_FLAGS_A, ctx->counter + i);
+
+    ctx->burst = true;
+    SYS_EncryptBlocksReq(ctx->stream, ctx->blocks, ctx->key);
     return;
+  }
 
-  if (nwkSecurityActiveFrame)
+  if (!ctx->ready)
   {
-    if (NWK_SECURITY_STATE_CONFIRM == nwkSecurityActiveFrame->state)
-    {
-      bool micStatus = nwkSecurityProcessMic();
+    uint8_t *text = &ctx->frame->payload[ctx->offset];
+    uint8_t *stream = &ctx->stream[(ctx->block - ctx->counter) * NWK_SECURITY_BLOCK_SIZE];
+    uint8_t block;
+
+    block = (ctx->size - ctx->offset < NWK_SECURITY_BLOCK_SIZE) ?
+        (ctx->size - ctx->offset) : NWK_SECURITY_BLOCK_SIZE;
 
-      if (nwkSecurityEncrypt)
-        nwkTxEncryptConf(nwkSecurityActiveFrame);
+    for (uint8_t i = 0; i < block; i++)
+    {
+      if (ctx->encrypt)
+      {
+        vector[i] ^= text[i];
+        text[i] ^= stream[i];
+      }
       else
-        nwkRxDecryptConf(nwkSecurityActiveFrame, micStatus);
+      {
+        text[i] ^= stream[i];
+        vector[i] ^= text[i];
+      }
+    }
+
+    ctx->offset += block;
+    ctx->block++;
+  }
+
+  ctx->burst = false;
+  SYS_EncryptReq(vector, ctx->key);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSecurityConfirm(NwkSecurityContext_t *ctx)
+{
+  uint8_t *vector = (uint8_t *)ctx->vector;
+
+  if (ctx->burst)
+  {
+    if (0 == ctx->counter)
+      memcpy(ctx->mask, ctx->stream, NWK_SECURITY_MIC_SIZE);
+  }
+  else if (0 == ctx->block)
+  {
+    nwkSecurityMacHeader(ctx, vector);
+    ctx->block = 1;
+  }
+  else
+  {
+    ctx->ready = false;
+    ctx->done = (ctx->offset == ctx->size);
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static bool nwkSecurityProcessMic(NwkSecurityContext_t *ctx)
+{
+  uint8_t *mic = &ctx->frame->payload[ctx->size];
+  uint8_t *vector = (uint8_t *)ctx->vector;
+  uint8_t diff = 0;
+
+  for (uint8_t i = 0; i < NWK_SECURITY_MIC_SIZE; i++)
+  {
+    if (ctx->encrypt)
+      mic[i] = vector[i] ^ ctx->mask[i];
+    else
+      diff |= mic[i] ^ vector[i] ^ ctx->mask[i];
+  }
 
-      nwkSecurityActiveFrame = NULL;
-      --nwkSecurityActiveFrames;
+  if (ctx->encrypt)
+    ctx->frame->size += NWK_SECURITY_MIC_SIZE;
+
+  return 0 == diff;
+}
+
+#elif NWK_SECURITY_MODE == 2
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSecurityStartFrame(NwkSecurityContext_t *ctx)
+{
+  nwkSecurityCcmBlock(ctx, (uint8_t *)ctx->vector, NWK_SECURITY_CCM_FLAGS_B0, ctx->size);
+  ctx->counter = 1;
+  ctx->block = 0;
+  ctx->ready = true;
+  ctx->valid = true;
+  ctx->mac = !ctx->encrypt || 0 == ctx->size;
+}
+
+/*************************************************************************//**
+  @brief Issues the next cipher request for the context @a ctx
+
+  Outgoing frames are encrypted in counter mode first and the CBC-MAC is
+  then computed over the cipher text. Incoming frames run the MAC first,
+  so forged frames are rejected without spending time on decryption.
+*****************************************************************************/
+static void nwkSecurityRequest(NwkSecurityContext_t *ctx)
+{
+  uint8_t *vector = (uint8_t *)ctx->vector;
+  uint8_t left = ctx->size - ctx->offset;
+
+  if (!ctx->mac)
+  {
+    ctx->blocks = (left + NWK_SECURITY_BLOCK_SIZE - 1) / NWK_SECURITY_BLOCK_SIZE;
+    if (ctx->blocks > NWK_SECURITY_CCM_BURST)
+      ctx->blocks = NWK_SECURITY_CCM_BURST;
+
+    for (uint8_t i = 0; i < ctx->blocks; i++)
+      nwkSecurityCcmBlock(ctx, &ctx->stream[i * NWK_SECURITY_BLOCK_SIZE],
+          NWK_SECURITY_CCM_FLAGS_A, ctx->counter + i);
+
+    SYS_EncryptBlocksReq(ctx->stream, ctx->blocks, ctx->key);
+    return;
+  }
+
+  if (!ctx->ready)
+  {
+    uint8_t *text = &ctx->frame->payload[ctx->offset];
+    uint8_t block = (left < NWK_SECURITY_BLOCK_SIZE) ? left : NWK_SECURITY_BLOCK_SIZE;
+
+    for (uint8_t i = 0; i < block; i++)
+      vector[i] ^= text[i];
+
+    ctx->offset += block;
+  }
+
+  SYS_EncryptReq(vector, ctx->key);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSecurityConfirm(NwkSecurityContext_t *ctx)
+{
+  uint8_t *vector = (uint8_t *)ctx->vector;
+
+  if (!ctx->mac)
+  {
+    uint8_t *text = &ctx->frame->payload[ctx->offset];
+    uint8_t size = ctx->size - ctx->offset;
+
+    if (size > ctx->blocks * NWK_SECURITY_BLOCK_SIZE)
+      size = ctx->blocks * NWK_SECURITY_BLOCK_SIZE;
+
+    for (uint8_t i = 0; i < size; i++)
+      text[i] ^= ctx->stream[i];
+
+    ctx->offset += size;
+    ctx->counter += ctx->blocks;
+
+    if (ctx->offset == ctx->size)
+    {
+      ctx->mac = ctx->encrypt;
+      ctx->done = !ctx->encrypt;
+      ctx->offset = 0;
     }
-    else if (NWK_SECURITY_STATE_PROCESS == nwkSecurityActiveFrame->state)
+  }
+  else if (0 == ctx->block)
+  {
+    nwkSecurityMacHeader(ctx, vector);
+    ctx->block = 1;
+  }
+  else
+  {
+    ctx->ready = false;
+
+    if (ctx->offset < ctx->size)
+      return;
+
+    if (!ctx->encrypt)
     {
-      nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_WAIT;
-      SYS_EncryptReq((uint8_t *)nwkSecurityVector, (uint8_t *)nwkIb.key);
+      uint8_t *mic = &ctx->frame->payload[ctx->size];
+      uint8_t diff = 0;
+
+      for (uint8_t i = 0; i < NWK_SECURITY_MIC_SIZE; i++)
+        diff |= mic[i] ^ vector[i];
+
+      ctx->valid = (0 == diff);
+
+      if (ctx->valid && ctx->size)
+      {
+        ctx->mac = false;
+        ctx->offset = 0;
+        return;
+      }
     }
 
+    ctx->done = true;
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static bool nwkSecurityProcessMic(NwkSecurityContext_t *ctx)
+{
+  if (ctx->encrypt)
+  {
+    memcpy(&ctx->frame->payload[ctx->size], (uint8_t *)ctx->vector, NWK_SECURITY_MIC_SIZE);
+    ctx->frame->size += NWK_SECURITY_MIC_SIZE;
+  }
+
+  return ctx->valid;
+}
+#endif
+#endif
+
+/*************************************************************************//**
+  @brief Binds a pending @a frame to the cipher context @a ctx
+*****************************************************************************/
+static void nwkSecurityStart(NwkSecurityContext_t *ctx, NwkFrame_t *frame)
+{
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  bool counterInserted = false;
+#endif
+
+  if (NWK_SECURITY_STATE_DECRYPT_PENDING == frame->state)
+    frame->size -= NWK_SECURITY_MIC_SIZE;
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  else
+    counterInserted = nwkSecurityFrameCounterInsert(frame);
+#endif
+
+  ctx->frame = frame;
+  ctx->size = nwkFramePayloadSize(frame);
+  ctx->offset = 0;
+  ctx->encrypt = (NWK_SECURITY_STATE_ENCRYPT_PENDING == frame->state);
+#ifdef NWK_ENABLE_KEY_TABLE
+  ctx->key = nwkSecurityFrameKey(frame);
+#else
+  ctx->key = (uint8_t *)nwkIb.key;
+#endif
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  if (ctx->encrypt ? !counterInserted : !nwkSecurityFrameCounterCheck(frame))
+    ctx->key = NULL;
+#endif
+  ctx->done = (NULL == ctx->key);
+
+  nwkSecurityStartFrame(ctx);
+
+  frame->state = NWK_SECURITY_STATE_PROCESS;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void SYS_EncryptConf(void)
+{
+  nwkSecurityConfirm(nwkSecurityActiveContext);
+  nwkSecurityActiveContext = NULL;
+}
+
+/*************************************************************************//**
+  @brief Completes processing of the frame bound to the context @a ctx
+*****************************************************************************/
+static void nwkSecurityFinish(NwkSecurityContext_t *ctx)
+{
+  bool micStatus = ctx->key && nwkSecurityProcessMic(ctx);
+
+#ifdef NWK_ENABLE_FRAME_COUNTER
+  if (!ctx->encrypt && micStatus)
+    nwkSecurityFrameCounterAccept(ctx->frame);
+#endif
+
+  if (!ctx->encrypt && !micStatus)
+    nwkIb.securityRejects++;
+
+  if (ctx->encrypt && NULL == ctx->key)
+    nwkTxConfirm(ctx->frame, NWK_ERROR_STATUS);
+  else if (ctx->encrypt)
+    nwkTxEncryptConf(ctx->frame);
+  else
+    nwkRxDecryptConf(ctx->frame, micStatus);
+
+  ctx->frame = NULL;
+  --nwkSecurityActiveFrames;
+}
+
+/*************************************************************************//**
+  @brief Security Module task handler
+
+  Blocks of each frame are passed to the cipher back to back for as long
+  as it completes them synchronously. An asynchronous cipher leaves the
+  active context in place until SYS_EncryptConf() is called.
+*****************************************************************************/
+void nwkSecurityTaskHandler(void)
+{
+  NwkFrame_t *frame = NULL;
+  uint8_t free = 0;
+
+  if (0 == nwkSecurityActiveFrames || nwkSecurityActiveContext)
     return;
+
+  for (uint8_t i = 0; i < NWK_SECURITY_CONTEXTS; i++)
+  {
+    if (NULL == nwkSecurityContexts[i].frame)
+      free++;
   }
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  while (free && NULL != (frame = nwkFrameNext(frame)))
   {
     if (NWK_SECURITY_STATE_ENCRYPT_PENDING == frame->state ||
         NWK_SECURITY_STATE_DECRYPT_PENDING == frame->state)
     {
-      nwkSecurityActiveFrame = frame;
-      nwkSecurityStart();
-      return;
+      for (uint8_t i = 0; i < NWK_SECURITY_CONTEXTS; i++)
+      {
+        if (NULL == nwkSecurityContexts[i].frame)
+        {
+          nwkSecurityStart(&nwkSecurityContexts[i], frame);
+          free--;
+          break;
+        }
+      }
     }
   }
+
+  for (uint8_t i = 0; i < NWK_SECURITY_CONTEXTS; i++)
+  {
+    NwkSecurityContext_t *ctx = &nwkSecurityContexts[i];
+
+    if (NULL == ctx->frame)
+      continue;
+
+    while (!ctx->done)
+    {
+      nwkSecurityActiveContext = ctx;
+      nwkSecurityRequest(ctx);
+
+      if (nwkSecurityActiveContext)
+        return;
+    }
+
+    nwkSecurityFinish(ctx);
+  }
 }
 
 #endif // NWK_ENABLE_SECURITY
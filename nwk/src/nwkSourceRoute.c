@@ -0,0 +1,431 @@
+/**
+ * \file nwkSourceRoute.c
+ *
+ * \brief Source routing implementation
+ *
+ * Copyright (C) 2012-2014, Atmel Corporation. All rights reserved.
+ *
+ * \asf_license_start
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. The name of Atmel may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. This software may only be redistributed and used in connection with an
+ *    Atmel microcontroller product.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * EXPRESSLY AND SPECIFICALLY DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \asf_license_stop
+ *
+ * Modification and other use of this code is subject to Atmel's Limited
+ * License Agreement (license.txt).
+ *
+ * $Id$
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sysTypes.h"
+#include "sysConfig.h"
+#include "nwk.h"
+#include "nwkTx.h"
+#include "nwkFrame.h"
+#include "nwkRoute.h"
+#include "nwkSourceRoute.h"
+
+#ifdef NWK_ENABLE_SOURCE_ROUTING
+
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_SOURCE_ROUTE_MAX_FRAME_SIZE   (NWK_FRAME_MAX_PAYLOAD_SIZE - 2/*crc*/)
+
+/*- Types ------------------------------------------------------------------*/
+typedef struct NwkSourceRouteEntry_t
+{
+  uint16_t addr;
+  uint16_t parent;
+} NwkSourceRouteEntry_t;
+
+/*- Variables --------------------------------------------------------------*/
+static NwkSourceRouteEntry_t nwkSourceRouteTable[NWK_SOURCE_ROUTE_TABLE_SIZE];
+static uint8_t nwkSourceRouteReplace;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Initializes the Source Routing module
+*****************************************************************************/
+void nwkSourceRouteInit(void)
+{
+  for (uint8_t i = 0; i < NWK_SOURCE_ROUTE_TABLE_SIZE; i++)
+    nwkSourceRouteTable[i].addr = NWK_ROUTE_UNKNOWN;
+
+  nwkSourceRouteReplace = 0;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static uint8_t nwkSourceRouteHeaderSize(NwkFrameSourceRouteHeader_t *srHeader)
+{
+  return sizeof(NwkFrameSourceRouteHeader_t) + srHeader->count * sizeof(uint16_t);
+}
+
+/*************************************************************************//**
+  @brief Returns the number of bytes security will still add to the @a frame
+  @param[in] frame Pointer to the frame being prepared for transmission
+  @return Size of the MIC and the frame counter if the frame is not encrypted yet
+*****************************************************************************/
+static uint8_t nwkSourceRouteSecuritySize(NwkFrame_t *frame)
+{
+  uint8_t size = 0;
+
+#ifdef NWK_ENABLE_SECURITY
+  // Routed frames were encrypted by the originator
+  if (frame->header.nwkFcf.security && 0 == (frame->tx.control & NWK_TX_CONTROL_ROUTING))
+  {
+    size += NWK_SECURITY_MIC_SIZE;
+  #ifdef NWK_ENABLE_FRAME_COUNTER
+    size += sizeof(uint32_t);
+  #endif
+  }
+#else
+  (void)frame;
+#endif
+
+  return size;
+}
+
+/*************************************************************************//**
+  @brief Opens a gap of @a size bytes for the extension header data
+  @param[in] frame Pointer to the frame
+  @param[in] offset Offset of the gap from the beginning of the frame
+  @param[in] size Size of the gap
+  @param[in] reserve Number of bytes that will be added to the frame later
+  @return @c false if the frame would exceed maximum size
+*****************************************************************************/
+static bool nwkSourceRouteInsert(NwkFrame_t *frame, uint8_t offset, uint8_t size,
+    uint8_t reserve)
+{
+  if (frame->size + size + reserve > NWK_SOURCE_ROUTE_MAX_FRAME_SIZE)
+    return false;
+
+  memmove(frame->data + offset + size, frame->data + offset, frame->size - offset);
+  frame->payload += size;
+  frame->size += size;
+
+  return true;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static NwkSourceRouteEntry_t *nwkSourceRouteFindEntry(uint16_t addr)
+{
+  for (uint8_t i = 0; i < NWK_SOURCE_ROUTE_TABLE_SIZE; i++)
+  {
+    if (nwkSourceRouteTable[i].addr == addr)
+      return &nwkSourceRouteTable[i];
+  }
+
+  return NULL;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkSourceRouteUpdateEntry(uint16_t addr, uint16_t parent)
+{
+  NwkSourceRouteEntry_t *entry;
+
+  entry = nwkSourceRouteFindEntry(addr);
+
+  if (NULL == entry)
+    entry = nwkSourceRouteFindEntry(NWK_ROUTE_UNKNOWN);
+
+  if (NULL == entry)
+  {
+    entry = &nwkSourceRouteTable[nwkSourceRouteReplace];
+
+    if (++nwkSourceRouteReplace == NWK_SOURCE_ROUTE_TABLE_SIZE)
+      nwkSourceRouteReplace = 0;
+  }
+
+  entry->addr = addr;
+  entry->parent = parent;
+}
+
+/*************************************************************************//**
+  @brief Removes a source route to the node @a dst
+  @param[in] dst Destination address
+*****************************************************************************/
+void NWK_SourceRouteRemove(uint16_t dst)
+{
+  NwkSourceRouteEntry_t *entry;
+
+  entry = nwkSourceRouteFindEntry(dst);
+  if (entry)
+    entry->addr = NWK_ROUTE_UNKNOWN;
+}
+
+/*************************************************************************//**
+  @brief Updates parent pointers from the route record of the received @a frame
+*****************************************************************************/
+static void nwkSourceRouteRecordReceived(NwkFrame_t *frame)
+{
+  NwkFrameSourceRouteHeader_t *srHeader = nwkFrameSourceRouteHeader(frame);
+  uint16_t addr = frame->header.nwkSrcAddr;
+
+  if (srHeader->index)
+    return;
+
+  for (uint8_t i = 0; i < srHeader->count; i++)
+  {
+    nwkSourceRouteUpdateEntry(addr, srHeader->hops[i]);
+    addr = srHeader->hops[i];
+  }
+
+  nwkSourceRouteUpdateEntry(addr, nwkIb.addr);
+}
+
+/*************************************************************************//**
+  @brief Builds a list of hops to the node @a dst from the parent pointers
+  @param[in] dst Destination address
+  @param[out] hops List of the intermediate hops in the order of traversal
+  @return Amount of the intermediate hops or 0xff if the route is unknown
+*****************************************************************************/
+static uint8_t nwkSourceRouteBuild(uint16_t dst, uint16_t *hops)
+{
+  NwkSourceRouteEntry_t *entry;
+  uint16_t addr = dst;
+  uint8_t count = 0;
+
+  while (1)
+  {
+    if (NULL == (entry = nwkSourceRouteFindEntry(addr)))
+      return 0xff;
+
+    if (entry->parent == nwkIb.addr)
+      break;
+
+    if (NWK_SOURCE_ROUTE_MAX_HOPS == count)
+      return 0xff;
+
+    hops[count++] = entry->parent;
+    addr = entry->parent;
+  }
+
+  for (uint8_t i = 0; i < count / 2; i++)
+  {
+    uint16_t hop = hops[i];
+    hops[i] = hops[count - i - 1];
+    hops[count - i - 1] = hop;
+  }
+
+  return count;
+}
+
+/*************************************************************************//**
+  @brief Returns the size of the route record nwkSourceRouteRecordInit() will
+    add to the @a frame
+  @param[in] frame Pointer to the frame with the destination address set
+  @return Size of the empty route record or 0 if no record is needed
+*****************************************************************************/
+uint8_t nwkSourceRouteRecordSize(NwkFrame_t *frame)
+{
+  if (NWK_SOURCE_ROUTE_COORDINATOR_ADDR == nwkIb.addr ||
+      NWK_SOURCE_ROUTE_COORDINATOR_ADDR != frame->header.nwkDstAddr ||
+      frame->header.nwkFcf.linkLocal || frame->header.nwkFcf.multicast ||
+      (frame->tx.control & NWK_TX_CONTROL_BROADCAST_PAN_ID))
+    return 0;
+
+  return sizeof(NwkFrameSourceRouteHeader_t);
+}
+
+/*************************************************************************//**
+  @brief Adds an empty route record to the frame sent to the coordinator
+  @param[in] frame Pointer to the frame
+*****************************************************************************/
+void nwkSourceRouteRecordInit(NwkFrame_t *frame)
+{
+  NwkFrameSourceRouteHeader_t *srHeader = nwkFrameSourceRouteHeader(frame);
+  uint8_t size;
+
+  if (0 == (size = nwkSourceRouteRecordSize(frame)))
+    return;
+
+  if (!nwkSourceRouteInsert(frame, (uint8_t *)srHeader - frame->data, size,
+      nwkSourceRouteSecuritySize(frame)))
+    return;
+
+  srHeader->count = 0;
+  srHeader->index = 0;
+  srHeader->record = 1;
+
+  frame->header.nwkFcf.sourceRoute = 1;
+}
+
+/*************************************************************************//**
+  @brief Validates the source route header of the received @a frame
+  @param[in] frame Pointer to the received frame
+  @return @c false if the frame must be dropped
+*****************************************************************************/
+bool nwkSourceRouteFrameReceived(NwkFrame_t *frame)
+{
+  NwkFrameHeader_t *header = &frame->header;
+  NwkFrameSourceRouteHeader_t *srHeader = nwkFrameSourceRouteHeader(frame);
+  uint8_t offset = (uint8_t *)srHeader - frame->data;
+  uint8_t size;
+
+  if (0 == header->nwkFcf.sourceRoute)
+    return true;
+
+  if (frame->size < (uint8_t)(offset + sizeof(NwkFrameSourceRouteHeader_t)))
+    return false;
+
+  size = nwkSourceRouteHeaderSize(srHeader);
+
+  if (srHeader->count > NWK_SOURCE_ROUTE_MAX_HOPS || frame->size < offset + size ||
+      header->nwkFcf.multicast || NWK_BROADCAST_ADDR == header->nwkDstAddr)
+    return false;
+
+  frame->payload += size;
+
+  if (srHeader->record)
+  {
+    if (nwkIb.addr == header->nwkDstAddr && nwkIb.addr == NWK_SOURCE_ROUTE_COORDINATOR_ADDR)
+      nwkSourceRouteRecordReceived(frame);
+  }
+  else if (nwkIb.addr != header->nwkDstAddr && nwkIb.addr == header->macDstAddr)
+  {
+    if (srHeader->index >= srHeader->count || srHeader->hops[srHeader->index] != nwkIb.addr)
+      return false;
+
+    srHeader->index++;
+  }
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Selects the next hop for the source routed @a frame
+  @param[in] frame Pointer to the frame being sent
+  @return @c true if the next hop was selected by the source route
+*****************************************************************************/
+bool nwkSourceRoutePrepareTx(NwkFrame_t *frame)
+{
+  NwkFrameHeader_t *header = &frame->header;
+  NwkFrameSourceRouteHeader_t *srHeader = nwkFrameSourceRouteHeader(frame);
+  uint16_t hops[NWK_SOURCE_ROUTE_MAX_HOPS];
+  uint8_t count;
+
+  if (header->nwkFcf.sourceRoute)
+  {
+    if (srHeader->record)
+      return false;
+  }
+  else
+  {
+    if (NWK_SOURCE_ROUTE_COORDINATOR_ADDR != nwkIb.addr || header->nwkSrcAddr != nwkIb.addr ||
+        header->nwkFcf.multicast)
+      return false;
+
+    if (0xff == (count = nwkSourceRouteBuild(header->nwkDstAddr, hops)))
+      return false;
+
+    if (0 == count)
+    {
+      header->macDstAddr = header->nwkDstAddr;
+      return true;
+    }
+
+    if (!nwkSourceRouteInsert(frame, (uint8_t *)srHeader - frame->data,
+        sizeof(NwkFrameSourceRouteHeader_t) + count * sizeof(uint16_t),
+        nwkSourceRouteSecuritySize(frame)))
+      return false;
+
+    srHeader->count = count;
+    srHeader->index = 0;
+    srHeader->record = 0;
+    memcpy(srHeader->hops, hops, count * sizeof(uint16_t));
+
+    header->nwkFcf.sourceRoute = 1;
+  }
+
+  if (srHeader->index < srHeader->count)
+    header->macDstAddr = srHeader->hops[srHeader->index];
+  else
+    header->macDstAddr = header->nwkDstAddr;
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Forwards the source routed @a frame or appends a route record
+  @param[in] frame Pointer to the frame to be routed
+  @return @c true if the frame was handled and regular routing must be skipped
+*****************************************************************************/
+bool nwkSourceRouteFrame(NwkFrame_t *frame)
+{
+  NwkFrameSourceRouteHeader_t *srHeader = nwkFrameSourceRouteHeader(frame);
+
+  if (0 == frame->header.nwkFcf.sourceRoute)
+    return false;
+
+  if (0 == srHeader->record)
+  {
+    frame->tx.confirm = NULL;
+    frame->tx.control = NWK_TX_CONTROL_ROUTING;
+    nwkTxFrame(frame);
+    return true;
+  }
+
+  if (srHeader->index)
+    return false;
+
+  if (NWK_SOURCE_ROUTE_MAX_HOPS == srHeader->count ||
+      !nwkSourceRouteInsert(frame, (uint8_t *)srHeader - frame->data +
+          nwkSourceRouteHeaderSize(srHeader), sizeof(uint16_t), 0))
+  {
+    // Route record overflow, let the coordinator know that it is incomplete
+    srHeader->index = 1;
+    return false;
+  }
+
+  srHeader->hops[srHeader->count++] = nwkIb.addr;
+
+  return false;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void nwkSourceRouteFrameSent(NwkFrame_t *frame)
+{
+  if (NWK_SUCCESS_STATUS == frame->tx.status || NWK_SOURCE_ROUTE_COORDINATOR_ADDR != nwkIb.addr ||
+      frame->header.nwkSrcAddr != nwkIb.addr || frame->header.nwkFcf.multicast)
+    return;
+
+  NWK_SourceRouteRemove(frame->header.nwkDstAddr);
+}
+
+#endif // NWK_ENABLE_SOURCE_ROUTING
@@ -62,7 +62,6 @@
 /*- Definitions ------------------------------------------------------------*/
 #define NWK_TX_ACK_WAIT_TIMER_INTERVAL    5 // ms
 #define NWK_TX_DELAY_TIMER_INTERVAL       1 // ms
-#define NWK_TX_DELAY_JITTER_MASK          0x07
 
 /*- Types ------------------------------------------------------------------*/
 enum
@@ -85,6 +84,9 @@ static void nwkTxDelayTimerHandler(SYS_Timer_t *timer);
 static NwkFrame_t *nwkTxPhyActiveFrame;
 static SYS_Timer_t nwkTxAckWaitTimer;
 static SYS_Timer_t nwkTxDelayTimer;
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+static uint16_t nwkTxBroadcastDensity;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -94,6 +96,9 @@ static SYS_Timer_t nwkTxDelayTimer;
 void nwkTxInit(void)
 {
   nwkTxPhyActiveFrame = NULL;
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+  nwkTxBroadcastDensity = 0;
+#endif
 
   nwkTxAckWaitTimer.interval = NWK_TX_ACK_WAIT_TIMER_INTERVAL;
   nwkTxAckWaitTimer.mode = SYS_TIMER_INTERVAL_MODE;
@@ -104,6 +109,100 @@ void nwkTxInit(void)
   nwkTxDelayTimer.handler = nwkTxDelayTimerHandler;
 }
 
+/*************************************************************************//**
+  @brief Returns a random broadcast delay in NWK_TX_DELAY_TIMER_INTERVAL units
+
+  The jitter window grows with the average number of rebroadcasts heard
+  from the neighbours, so that dense neighbourhoods spread their
+  transmissions over a longer time, and shrinks with the data rate.
+*****************************************************************************/
+static uint16_t nwkTxBroadcastJitter(void)
+{
+  uint16_t window = NWK_TX_BROADCAST_JITTER;
+  uint16_t minWindow;
+
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+  window += ((uint32_t)window * nwkTxBroadcastDensity) >> 4;
+
+  if (window > NWK_TX_BROADCAST_MAX_JITTER)
+    window = NWK_TX_BROADCAST_MAX_JITTER;
+#endif
+
+  // The delay timer cannot tick faster, so only the window is scaled and
+  // enough slots are kept for the neighbours to pick different ones, but
+  // never more than the window has at the base data rate
+  if (nwkIb.dataRate)
+  {
+    minWindow = window < NWK_TX_BROADCAST_MIN_JITTER ? window : NWK_TX_BROADCAST_MIN_JITTER;
+    window >>= nwkIb.dataRate;
+    if (window < minWindow)
+      window = minWindow;
+  }
+
+  return (rand() % window) + 1;
+}
+
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+/*************************************************************************//**
+  @brief Updates the neighbourhood density estimate when the delay of a
+         rebroadcast @a frame is over
+*****************************************************************************/
+static void nwkTxUpdateDensity(NwkFrame_t *frame)
+{
+  // Average number of copies heard, 1/16 units
+  nwkTxBroadcastDensity -= nwkTxBroadcastDensity >> 2;
+  nwkTxBroadcastDensity += (uint16_t)frame->tx.heard << 2;
+}
+
+/*************************************************************************//**
+  @brief Counts a copy of the broadcast @a frame rebroadcast by a neighbour
+*****************************************************************************/
+void nwkTxBroadcastHeard(NwkFrame_t *frame)
+{
+  nwkTxBroadcastCopyHeard(frame->header.nwkSrcAddr, frame->header.nwkSeq, frame->rx.rssi);
+}
+
+/*************************************************************************//**
+  @brief Counts a copy of the pending broadcast identified by @a src and @a seq
+  @param[in] src NWK source address of the pending broadcast
+  @param[in] seq NWK sequence number of the pending broadcast
+  @param[in] rssi RSSI of the copy
+
+  A pending rebroadcast is cancelled once enough copies were heard with a
+  signal strong enough to assume that the rebroadcast would not reach any
+  new nodes. Route discovery uses this directly, since forwarded route
+  requests are new frames with the forwarder's own source and sequence.
+*****************************************************************************/
+void nwkTxBroadcastCopyHeard(uint16_t src, uint8_t seq, int8_t rssi)
+{
+  NwkFrame_t *pending = NULL;
+
+  while (NULL != (pending = nwkFrameNext(pending)))
+  {
+    if ((NWK_TX_STATE_DELAY != pending->state && NWK_TX_STATE_WAIT_DELAY != pending->state) ||
+        NWK_BROADCAST_ADDR != pending->header.macDstAddr ||
+        pending->header.nwkSrcAddr != src ||
+        pending->header.nwkSeq != seq)
+      continue;
+
+  #if NWK_TX_BROADCAST_SUPPRESSION_RSSI > -128
+    if (rssi < NWK_TX_BROADCAST_SUPPRESSION_RSSI)
+      return;
+  #else
+    (void)rssi;
+  #endif
+
+    if (++pending->tx.heard >= NWK_TX_BROADCAST_SUPPRESSION_THRESHOLD)
+    {
+      nwkTxUpdateDensity(pending);
+      nwkFrameFree(pending);
+    }
+
+    return;
+  }
+}
+#endif
+
 /*************************************************************************//**
 *****************************************************************************/
 void nwkTxFrame(NwkFrame_t *frame)
@@ -145,7 +244,7 @@ void nwkTxFrame(NwkFrame_t *frame)
   if (NWK_BROADCAST_ADDR == header->macDstAddr)
   {
     header->macFcf = 0x8841;
-    frame->tx.timeout = (rand() & NWK_TX_DELAY_JITTER_MASK) + 1;
+    frame->tx.timeout = nwkTxBroadcastJitter();
   }
   else
   {
@@ -166,7 +265,7 @@ void nwkTxBroadcastFrame(NwkFrame_t *frame)
   newFrame->state = NWK_TX_STATE_DELAY;
   newFrame->size = frame->size;
   newFrame->tx.status = NWK_SUCCESS_STATUS;
-  newFrame->tx.timeout = (rand() & NWK_TX_DELAY_JITTER_MASK) + 1;
+  newFrame->tx.timeout = nwkTxBroadcastJitter();
   newFrame->tx.confirm = NULL;
   memcpy(newFrame->data, frame->data, frame->size);
 
@@ -253,7 +352,13 @@ static void nwkTxDelayTimerHandler(SYS_Timer_t *timer)
       restart = true;
 
       if (0 == --frame->tx.timeout)
+      {
         frame->state = NWK_TX_STATE_SEND;
+      #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+        if (NWK_BROADCAST_ADDR == frame->header.macDstAddr)
+          nwkTxUpdateDensity(frame);
+      #endif
+      }
     }
   }
 
@@ -281,6 +386,27 @@ static uint8_t nwkTxConvertPhyStatus(uint8_t status)
   }
 }
 
+#ifdef NWK_ENABLE_TX_POLICY
+/*************************************************************************//**
+  @brief Selects the PHY retry and backoff parameters for the @a frame
+
+  Broadcasts are not acknowledged and get fewer CSMA-CA attempts, while
+  forwarded unicast frames get more retries than the frames originated by
+  this node, since losing them wastes the transmissions already made by the
+  previous hops.
+*****************************************************************************/
+static void nwkTxSetPhyParams(NwkFrame_t *frame)
+{
+  if (NWK_BROADCAST_ADDR == frame->header.macDstAddr)
+    PHY_SetTxParams(0, NWK_TX_BROADCAST_CSMA_RETRIES, NWK_TX_MIN_BE, NWK_TX_MAX_BE);
+  else if (frame->header.nwkSrcAddr == nwkIb.addr)
+    PHY_SetTxParams(NWK_TX_FRAME_RETRIES, NWK_TX_CSMA_RETRIES, NWK_TX_MIN_BE, NWK_TX_MAX_BE);
+  else
+    PHY_SetTxParams(NWK_TX_FORWARD_FRAME_RETRIES, NWK_TX_FORWARD_CSMA_RETRIES,
+        NWK_TX_MIN_BE, NWK_TX_MAX_BE);
+}
+#endif
+
 /*************************************************************************//**
 *****************************************************************************/
 void PHY_DataConf(uint8_t status)
@@ -328,6 +454,9 @@ void nwkTxTaskHandler(void)
         {
           nwkTxPhyActiveFrame = frame;
           frame->state = NWK_TX_STATE_WAIT_CONF;
+        #ifdef NWK_ENABLE_TX_POLICY
+          nwkTxSetPhyParams(frame);
+        #endif
           PHY_DataReq(frame->data, frame->size);
           nwkIb.lock++;
         }
@@ -342,8 +471,15 @@ void nwkTxTaskHandler(void)
         {
           if (frame->header.nwkSrcAddr == nwkIb.addr && frame->header.nwkFcf.ackRequest)
           {
+            // The acknowledgement may travel many hops and wait for route
+            // discoveries, so only a part of the wait time scales with the rate
+            uint16_t wait = NWK_ACK_WAIT_TIME >> nwkIb.dataRate;
+
+            if (wait < NWK_ACK_WAIT_MIN_TIME)
+              wait = NWK_ACK_WAIT_MIN_TIME;
+
             frame->state = NWK_TX_STATE_WAIT_ACK;
-            frame->tx.timeout = NWK_ACK_WAIT_TIME / NWK_TX_ACK_WAIT_TIMER_INTERVAL + 1;
+            frame->tx.timeout = wait / NWK_TX_ACK_WAIT_TIMER_INTERVAL + 1;
             SYS_TimerStart(&nwkTxAckWaitTimer);
           }
           else
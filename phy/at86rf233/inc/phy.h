@@ -57,6 +57,7 @@
 
 #define PHY_HAS_RANDOM_NUMBER_GENERATOR
 #define PHY_HAS_AES_MODULE
+#define PHY_HAS_HIGH_DATA_RATES
 
 /*- Types ------------------------------------------------------------------*/
 typedef struct PHY_DataInd_t
@@ -75,6 +76,14 @@ enum
   PHY_STATUS_ERROR                  = 3,
 };
 
+enum
+{
+  PHY_DATA_RATE_250K  = 0,
+  PHY_DATA_RATE_500K  = 1,
+  PHY_DATA_RATE_1000K = 2,
+  PHY_DATA_RATE_2000K = 3,
+};
+
 #if defined(PHY_ENABLE_FRONTEND) || defined(PHY_ENABLE_RF_SWITCH)
 enum
 {
@@ -92,9 +101,13 @@ void PHY_SetChannel(uint8_t channel);
 void PHY_SetPanId(uint16_t panId);
 void PHY_SetShortAddr(uint16_t addr);
 void PHY_SetTxPower(uint8_t txPower);
+void PHY_SetPromiscuousMode(bool mode);
+void PHY_SetTxParams(uint8_t frameRetries, uint8_t csmaRetries, uint8_t minBe, uint8_t maxBe);
+void PHY_SetDataRate(uint8_t rate);
 void PHY_Sleep(void);
 void PHY_Wakeup(void);
 void PHY_DataReq(uint8_t *data, uint8_t size);
+uint16_t PHY_GetRxAborts(void);
 void PHY_DataConf(uint8_t status);
 void PHY_DataInd(PHY_DataInd_t *ind);
 void PHY_TaskHandler(void);
@@ -107,6 +120,9 @@ uint16_t PHY_RandomReq(void);
 
 #ifdef PHY_ENABLE_AES_MODULE
 void PHY_EncryptReq(uint8_t *text, uint8_t *key);
+void PHY_EncryptBlocksReq(uint8_t *blocks, uint8_t count, uint8_t *key);
+void PHY_EncryptStartReq(uint8_t *blocks, uint8_t count, uint8_t *key);
+void PHY_EncryptConf(void);
 #endif
 
 #ifdef PHY_ENABLE_ENERGY_DETECTION
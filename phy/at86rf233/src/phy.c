@@ -50,6 +50,7 @@
 
 /*- Includes ---------------------------------------------------------------*/
 #include <stdbool.h>
+#include <stddef.h>
 #include "phy.h"
 #include "halPhy.h"
 #include "at86rf233.h"
@@ -57,12 +58,16 @@
 /*- Definitions ------------------------------------------------------------*/
 #define PHY_CRC_SIZE    2
 
+#define PHY_XAH_CTRL_0_RESET    ((3<<MAX_FRAME_RETRES) | (4<<MAX_CSMA_RETRES))
+#define PHY_CSMA_BE_RESET       ((5<<MAX_BE) | (3<<MIN_BE))
+
 /*- Types ------------------------------------------------------------------*/
 typedef enum
 {
   PHY_STATE_INITIAL,
   PHY_STATE_IDLE,
   PHY_STATE_SLEEP,
+  PHY_STATE_TX_DEFERRED,
   PHY_STATE_TX_WAIT_END,
 } PhyState_t;
 
@@ -72,11 +77,33 @@ static uint8_t phyReadRegister(uint8_t reg);
 static bool phyWaitState(uint8_t state);
 static void phyTrxSetState(uint8_t state);
 static void phySetRxState(void);
+static bool phyRxBusy(void);
+static void phyTxStart(void);
+static void phyReceiveFrame(void);
+#ifdef PHY_ENABLE_AES_MODULE
+static void phyAesSetKey(uint8_t *key);
+static void phyAesWriteBlock(uint8_t *text, uint8_t *prev);
+static void phyAesReadBlock(uint8_t *text);
+static void phyAesTaskHandler(void);
+#endif
 
 /*- Variables --------------------------------------------------------------*/
 static PhyState_t phyState = PHY_STATE_INITIAL;
 static uint8_t phyRxBuffer[128];
 static bool phyRxState;
+static uint8_t phyXahCtrl0;
+static uint8_t phyCsmaBe;
+static uint8_t *phyTxData;
+static uint8_t phyTxSize;
+static bool phyRxPending;
+static uint16_t phyRxAborts;
+#ifdef PHY_ENABLE_AES_MODULE
+static uint8_t phyAesKey[AES_BLOCK_SIZE];
+static bool phyAesKeyValid;
+static uint8_t *phyAesBlocks;
+static uint8_t phyAesCount;
+static uint8_t phyAesIndex;
+#endif
 #ifdef PHY_ENABLE_FRONTEND
 static bool phyFrontendBypass;
 #endif
@@ -93,7 +120,14 @@ void PHY_Init(void)
 {
   HAL_PhyReset();
   phyRxState = false;
+  phyRxPending = false;
   phyState = PHY_STATE_IDLE;
+  phyXahCtrl0 = PHY_XAH_CTRL_0_RESET;
+  phyCsmaBe = PHY_CSMA_BE_RESET;
+#ifdef PHY_ENABLE_AES_MODULE
+  phyAesKeyValid = false;
+  phyAesCount = 0;
+#endif
 
 # ifdef PHY_ENABLE_FRONTEND
     phyFrontendBypass = true;
@@ -107,6 +141,11 @@ void PHY_Init(void)
       (1<<IRQ_MASK_MODE));
 
   phyWriteRegister(TRX_CTRL_2_REG, (1<<RX_SAFE_MODE) | (1<<OQPSK_SCRAM_EN));
+
+#ifdef PHY_ENABLE_IRQ
+  phyWriteRegister(IRQ_MASK_REG, (1<<TRX_END));
+  phyReadRegister(IRQ_STATUS_REG);
+#endif
 }
 
 /*************************************************************************//**
@@ -158,6 +197,70 @@ void PHY_SetTxPower(uint8_t txPower)
   phyWriteRegister(PHY_TX_PWR_REG, reg | txPower);
 }
 
+/*************************************************************************//**
+  @brief Enables or disables upload of the frames addressed to other nodes
+  @param[in] mode @c true to enable promiscuous mode
+
+  Acknowledgements are still sent only for the frames addressed to this node.
+*****************************************************************************/
+void PHY_SetPromiscuousMode(bool mode)
+{
+  uint8_t reg;
+
+  reg = phyReadRegister(XAH_CTRL_1_REG) & ~(1<<AACK_PROM_MODE);
+  phyWriteRegister(XAH_CTRL_1_REG, reg | ((mode ? 1 : 0)<<AACK_PROM_MODE));
+}
+
+/*************************************************************************//**
+  @brief Selects the O-QPSK data rate
+  @param[in] rate One of the PHY_DATA_RATE_* values
+
+  All nodes of the network must use the same data rate. The value is also
+  the base 2 logarithm of the speed up over 250 kb/s, which is what the
+  network layer uses to scale its timing. In the high data rate modes the
+  acknowledgement is sent after 2 symbols instead of 12 (AACK_ACK_TIME).
+*****************************************************************************/
+void PHY_SetDataRate(uint8_t rate)
+{
+  uint8_t reg;
+
+  reg = phyReadRegister(TRX_CTRL_2_REG) & ~(3<<OQPSK_DATA_RATE);
+  phyWriteRegister(TRX_CTRL_2_REG, reg | ((rate & 3)<<OQPSK_DATA_RATE));
+
+  reg = phyReadRegister(XAH_CTRL_1_REG) & ~(1<<AACK_ACK_TIME);
+  phyWriteRegister(XAH_CTRL_1_REG, reg | ((PHY_DATA_RATE_250K != rate ? 1 : 0)<<AACK_ACK_TIME));
+}
+
+/*************************************************************************//**
+  @brief Sets the retry and backoff parameters of the following transmissions
+  @param[in] frameRetries Retransmissions if no acknowledgement is received (0-15)
+  @param[in] csmaRetries CSMA-CA attempts if the channel is busy (0-5, 7 to
+    transmit without CSMA-CA)
+  @param[in] minBe Minimum backoff exponent
+  @param[in] maxBe Maximum backoff exponent (3-8)
+
+  Registers are only written when the values differ from the ones already
+  set, so the parameters can be set before every frame.
+*****************************************************************************/
+void PHY_SetTxParams(uint8_t frameRetries, uint8_t csmaRetries, uint8_t minBe, uint8_t maxBe)
+{
+  uint8_t xahCtrl0 = ((frameRetries & 0x0f)<<MAX_FRAME_RETRES) |
+      ((csmaRetries & 0x07)<<MAX_CSMA_RETRES);
+  uint8_t csmaBe = ((maxBe & 0x0f)<<MAX_BE) | ((minBe & 0x0f)<<MIN_BE);
+
+  if (xahCtrl0 != phyXahCtrl0)
+  {
+    phyWriteRegister(XAH_CTRL_0_REG, xahCtrl0);
+    phyXahCtrl0 = xahCtrl0;
+  }
+
+  if (csmaBe != phyCsmaBe)
+  {
+    phyWriteRegister(CSMA_BE_REG, csmaBe);
+    phyCsmaBe = csmaBe;
+  }
+}
+
 /*************************************************************************//**
 *****************************************************************************/
 void PHY_Sleep(void)
@@ -168,6 +271,9 @@ void PHY_Sleep(void)
   phyTrxSetState(TRX_CMD_TRX_OFF);
   HAL_PhySlpTrSet();
   phyState = PHY_STATE_SLEEP;
+#ifdef PHY_ENABLE_AES_MODULE
+  phyAesKeyValid = false; // AES registers are not retained in SLEEP
+#endif
 }
 
 /*************************************************************************//**
@@ -186,18 +292,71 @@ void PHY_Wakeup(void)
 }
 
 /*************************************************************************//**
+  @brief Requests transmission of the frame
+
+  If a frame is being received or a received frame has not been read yet,
+  the switch to TX_ARET_ON is deferred until PHY_TaskHandler() has read it,
+  so the reception is not aborted and the frame buffer is not overwritten.
+  The @a data must stay valid until PHY_DataConf() is called.
 *****************************************************************************/
 void PHY_DataReq(uint8_t *data, uint8_t size)
 {
+  phyTxData = data;
+  phyTxSize = size;
+  phyState = PHY_STATE_TX_DEFERRED;
+
+  phyTxStart();
+}
+
+/*************************************************************************//**
+  @brief Returns the number of receptions aborted by forced state changes
+*****************************************************************************/
+uint16_t PHY_GetRxAborts(void)
+{
+  return phyRxAborts;
+}
+
+/*************************************************************************//**
+  @brief Checks if a frame is being received or waits in the frame buffer
+*****************************************************************************/
+static bool phyRxBusy(void)
+{
+  uint8_t status;
+
+  if (phyReadRegister(IRQ_STATUS_REG) & (1<<TRX_END))
+    phyRxPending = true;
+
+  if (phyRxPending)
+    return true;
+
+  status = phyReadRegister(TRX_STATUS_REG) & TRX_STATUS_MASK;
+
+  return TRX_STATUS_BUSY_RX_AACK == status ||
+      TRX_STATUS_BUSY_RX_AACK_NOCLK == status;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void phyTxStart(void)
+{
+  if (phyRxBusy())
+    return;
+
   phyTrxSetState(TRX_CMD_TX_ARET_ON);
 
-  phyReadRegister(IRQ_STATUS_REG);
+  // A frame may have started right before the state change, in which case
+  // PLL_ON was executed only after the reception had completed
+  if (phyReadRegister(IRQ_STATUS_REG) & (1<<TRX_END))
+  {
+    phyRxPending = true;
+    return;
+  }
 
   HAL_PhySpiSelect();
   HAL_PhySpiWriteByte(RF_CMD_FRAME_W);
-  HAL_PhySpiWriteByte(size + PHY_CRC_SIZE);
-  for (uint8_t i = 0; i < size; i++)
-    HAL_PhySpiWriteByte(data[i]);
+  HAL_PhySpiWriteByte(phyTxSize + PHY_CRC_SIZE);
+  for (uint8_t i = 0; i < phyTxSize; i++)
+    HAL_PhySpiWriteByte(phyTxData[i]);
   HAL_PhySpiDeselect();
 
   phyState = PHY_STATE_TX_WAIT_END;
@@ -233,25 +392,118 @@ uint16_t PHY_RandomReq(void)
 *****************************************************************************/
 void PHY_EncryptReq(uint8_t *text, uint8_t *key)
 {
+  PHY_EncryptBlocksReq(text, 1, key);
+}
+
+/*************************************************************************//**
+  @brief Encrypts @a count independent 16-byte blocks in place (ECB mode)
+
+  The key is only written to the transceiver when it differs from the one
+  loaded by the previous request. Blocks are written using fast SRAM access,
+  so the result of the previous block is shifted out on MISO while the next
+  block is being written, and only the last result needs a separate read.
+*****************************************************************************/
+void PHY_EncryptBlocksReq(uint8_t *blocks, uint8_t count, uint8_t *key)
+{
+  uint8_t *prev = NULL;
+
+  if (0 == count)
+    return;
+
+  phyAesSetKey(key);
+
+  for (uint8_t block = 0; block < count; block++)
+  {
+    uint8_t *text = &blocks[block * AES_BLOCK_SIZE];
+
+    phyAesWriteBlock(text, prev);
+    HAL_Delay(AES_CORE_CYCLE_TIME);
+    prev = text;
+  }
+
+  phyAesReadBlock(prev);
+}
+
+/*************************************************************************//**
+  @brief Starts encryption of @a count blocks and returns immediately
+
+  Completion is polled from PHY_TaskHandler() and reported through
+  PHY_EncryptConf(). The blocks must stay valid until then, and no other
+  encryption request may be issued in the meantime.
+*****************************************************************************/
+void PHY_EncryptStartReq(uint8_t *blocks, uint8_t count, uint8_t *key)
+{
+  if (0 == count)
+  {
+    PHY_EncryptConf();
+    return;
+  }
+
+  phyAesSetKey(key);
+
+  phyAesBlocks = blocks;
+  phyAesCount = count;
+  phyAesIndex = 0;
+
+  phyAesWriteBlock(blocks, NULL);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void phyAesTaskHandler(void)
+{
+  uint8_t *prev = &phyAesBlocks[phyAesIndex * AES_BLOCK_SIZE];
+  uint8_t status;
+
   HAL_PhySpiSelect();
-  HAL_PhySpiWriteByte(RF_CMD_SRAM_W);
-  HAL_PhySpiWriteByte(AES_CTRL_REG);
-  HAL_PhySpiWriteByte((1<<AES_CTRL_MODE) | (0<<AES_CTRL_DIR));
-  for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
-    HAL_PhySpiWriteByte(key[i]);
+  HAL_PhySpiWriteByte(RF_CMD_SRAM_R);
+  HAL_PhySpiWriteByte(AES_STATUS_REG);
+  status = HAL_PhySpiWriteByte(0);
   HAL_PhySpiDeselect();
 
+  if (0 == (status & (1<<AES_STATUS_DONE)))
+    return;
+
+  if (++phyAesIndex < phyAesCount)
+  {
+    phyAesWriteBlock(&phyAesBlocks[phyAesIndex * AES_BLOCK_SIZE], prev);
+    return;
+  }
+
+  phyAesReadBlock(prev);
+  phyAesCount = 0;
+  PHY_EncryptConf();
+}
+
+/*************************************************************************//**
+  @brief Writes @a text and starts encryption, reading the result of the
+    previous block into @a prev (if not NULL) at the same time
+*****************************************************************************/
+static void phyAesWriteBlock(uint8_t *text, uint8_t *prev)
+{
+  uint8_t value;
+
   HAL_PhySpiSelect();
   HAL_PhySpiWriteByte(RF_CMD_SRAM_W);
   HAL_PhySpiWriteByte(AES_CTRL_REG);
   HAL_PhySpiWriteByte((0<<AES_CTRL_MODE) | (0<<AES_CTRL_DIR));
-  for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
-    HAL_PhySpiWriteByte(text[i]);
-  HAL_PhySpiWriteByte((1<<AES_CTRL_REQUEST) | (0<<AES_CTRL_MODE) | (0<<AES_CTRL_DIR));
+  HAL_PhySpiWriteByte(text[0]);
+  for (uint8_t i = 1; i < AES_BLOCK_SIZE; i++)
+  {
+    value = HAL_PhySpiWriteByte(text[i]);
+    if (prev)
+      prev[i-1] = value;
+  }
+  value = HAL_PhySpiWriteByte((1<<AES_CTRL_REQUEST) | (0<<AES_CTRL_MODE) | (0<<AES_CTRL_DIR));
+  if (prev)
+    prev[AES_BLOCK_SIZE-1] = value;
   HAL_PhySpiDeselect();
+}
 
-  HAL_Delay(AES_CORE_CYCLE_TIME);
-
+/*************************************************************************//**
+*****************************************************************************/
+static void phyAesReadBlock(uint8_t *text)
+{
   HAL_PhySpiSelect();
   HAL_PhySpiWriteByte(RF_CMD_SRAM_R);
   HAL_PhySpiWriteByte(AES_STATE_REG);
@@ -259,6 +511,35 @@ void PHY_EncryptReq(uint8_t *text, uint8_t *key)
     text[i] = HAL_PhySpiWriteByte(0);
   HAL_PhySpiDeselect();
 }
+
+/*************************************************************************//**
+*****************************************************************************/
+static void phyAesSetKey(uint8_t *key)
+{
+  bool reload = !phyAesKeyValid;
+
+  for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
+  {
+    if (phyAesKey[i] != key[i])
+    {
+      phyAesKey[i] = key[i];
+      reload = true;
+    }
+  }
+
+  if (!reload)
+    return;
+
+  HAL_PhySpiSelect();
+  HAL_PhySpiWriteByte(RF_CMD_SRAM_W);
+  HAL_PhySpiWriteByte(AES_CTRL_REG);
+  HAL_PhySpiWriteByte((1<<AES_CTRL_MODE) | (0<<AES_CTRL_DIR));
+  for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
+    HAL_PhySpiWriteByte(key[i]);
+  HAL_PhySpiDeselect();
+
+  phyAesKeyValid = true;
+}
 #endif
 
 #ifdef PHY_ENABLE_ENERGY_DETECTION
@@ -328,6 +609,11 @@ void PHY_FrontendSelectAntenna(uint8_t mode)
 
 void PHY_RunContinuousTest(void) {
   HAL_PhyReset();
+  phyXahCtrl0 = PHY_XAH_CTRL_0_RESET;
+  phyCsmaBe = PHY_CSMA_BE_RESET;
+#ifdef PHY_ENABLE_AES_MODULE
+  phyAesKeyValid = false;
+#endif
   phyWriteRegister(0x04, 0x00);
   phyWriteRegister(0x02, 0x03);
   phyWriteRegister(0x08, 0x33);
@@ -388,18 +674,55 @@ static bool phyWaitState(uint8_t state)
 *****************************************************************************/
 static void phySetRxState(void)
 {
-  phyTrxSetState(TRX_CMD_TRX_OFF);
-
   phyReadRegister(IRQ_STATUS_REG);
 
   if (phyRxState)
     phyTrxSetState(TRX_CMD_RX_AACK_ON);
+  else
+    phyTrxSetState(TRX_CMD_TRX_OFF);
 }
 
 /*************************************************************************//**
+  @brief Checks if @a state is one of the states with the PLL locked
+*****************************************************************************/
+static bool phyTrxPllState(uint8_t state)
+{
+  return TRX_STATUS_PLL_ON == state || TRX_STATUS_RX_ON == state ||
+      TRX_STATUS_RX_AACK_ON == state || TRX_STATUS_TX_ARET_ON == state;
+}
+
+/*************************************************************************//**
+  @brief Moves the transceiver to the @a state
+
+  Transitions between states with the PLL locked (for example RX_AACK_ON to
+  TX_ARET_ON and back) go through PLL_ON, which keeps the PLL running and
+  takes about 1 us instead of a full PLL settling time. Everything else, and
+  any direct transition that does not complete, falls back to FORCE_TRX_OFF.
 *****************************************************************************/
 static void phyTrxSetState(uint8_t state)
 {
+  uint8_t status = phyReadRegister(TRX_STATUS_REG) & TRX_STATUS_MASK;
+
+  if (state == status)
+    return;
+
+  if (phyTrxPllState(state) && phyTrxPllState(status))
+  {
+    if (TRX_STATUS_PLL_ON != status)
+      phyWriteRegister(TRX_STATE_REG, TRX_CMD_PLL_ON);
+
+    if (phyWaitState(TRX_STATUS_PLL_ON))
+    {
+      phyWriteRegister(TRX_STATE_REG, state);
+      if (phyWaitState(state))
+        return;
+    }
+  }
+
+  if (TRX_STATUS_BUSY_RX == status || TRX_STATUS_BUSY_RX_AACK == status ||
+      TRX_STATUS_BUSY_RX_AACK_NOCLK == status)
+    phyRxAborts++;
+
   for(uint8_t retries = 0; retries < 8; retries++) {
     phyWriteRegister(TRX_STATE_REG, TRX_CMD_FORCE_TRX_OFF);
     if(!phyWaitState(TRX_STATUS_TRX_OFF)) continue;
@@ -410,6 +733,39 @@ static void phyTrxSetState(uint8_t state)
   }
 }
 
+/*************************************************************************//**
+  @brief Reads the received frame and indicates it if the FCS is valid
+
+  In promiscuous mode the transceiver also uploads frames with a bad FCS.
+  They are still read to release the frame buffer protection, but dropped.
+*****************************************************************************/
+static void phyReceiveFrame(void)
+{
+  PHY_DataInd_t ind;
+  uint8_t size;
+  int8_t rssi;
+  bool crcValid;
+
+  crcValid = phyReadRegister(PHY_RSSI_REG) & (1<<RX_CRC_VALID);
+  rssi = (int8_t)phyReadRegister(PHY_ED_LEVEL_REG);
+
+  HAL_PhySpiSelect();
+  HAL_PhySpiWriteByte(RF_CMD_FRAME_R);
+  size = HAL_PhySpiWriteByte(0);
+  for (uint8_t i = 0; i < size + 1/*lqi*/; i++)
+    phyRxBuffer[i] = HAL_PhySpiWriteByte(0);
+  HAL_PhySpiDeselect();
+
+  if (!crcValid)
+    return;
+
+  ind.data = phyRxBuffer;
+  ind.size = size - PHY_CRC_SIZE;
+  ind.lqi  = phyRxBuffer[size];
+  ind.rssi = rssi + PHY_RSSI_BASE_VAL;
+  PHY_DataInd(&ind);
+}
+
 /*************************************************************************//**
 *****************************************************************************/
 void PHY_TaskHandler(void)
@@ -417,29 +773,34 @@ void PHY_TaskHandler(void)
   if (PHY_STATE_SLEEP == phyState)
     return;
 
+#ifdef PHY_ENABLE_AES_MODULE
+  if (phyAesCount)
+    phyAesTaskHandler();
+#endif
+
+  if (PHY_STATE_TX_DEFERRED == phyState)
+  {
+    if (phyRxPending)
+    {
+      phyRxPending = false;
+      phyReceiveFrame();
+    }
+
+    phyTxStart();
+    return;
+  }
+
+#ifdef PHY_ENABLE_IRQ
+  if (!HAL_PhyIrqPending())
+    return;
+#endif
+
   if (phyReadRegister(IRQ_STATUS_REG) & (1<<TRX_END))
   {
     if (PHY_STATE_IDLE == phyState)
     {
-      PHY_DataInd_t ind;
-      uint8_t size;
-      int8_t rssi;
-
-      rssi = (int8_t)phyReadRegister(PHY_ED_LEVEL_REG);
-
-      HAL_PhySpiSelect();
-      HAL_PhySpiWriteByte(RF_CMD_FRAME_R);
-      size = HAL_PhySpiWriteByte(0);
-      for (uint8_t i = 0; i < size + 1/*lqi*/; i++)
-        phyRxBuffer[i] = HAL_PhySpiWriteByte(0);
-      HAL_PhySpiDeselect();
-
-      ind.data = phyRxBuffer;
-      ind.size = size - PHY_CRC_SIZE;
-      ind.lqi  = phyRxBuffer[size];
-      ind.rssi = rssi + PHY_RSSI_BASE_VAL;
-      PHY_DataInd(&ind);
-      
+      phyReceiveFrame();
+
       for(uint8_t retries=0; retries<8; retries++) {
         if(phyWaitState(TRX_STATUS_RX_AACK_ON)) break;
       }
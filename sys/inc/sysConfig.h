@@ -64,21 +64,81 @@
 #endif
 
 #ifndef NWK_ROUTE_TABLE_SIZE
-#define NWK_ROUTE_TABLE_SIZE                     10
+#define NWK_ROUTE_TABLE_SIZE                     10 // up to 254 entries
 #endif
 
 #ifndef NWK_ROUTE_DEFAULT_SCORE
 #define NWK_ROUTE_DEFAULT_SCORE                  3
 #endif
 
+#ifndef NWK_ROUTE_ERROR_TABLE_SIZE
+#define NWK_ROUTE_ERROR_TABLE_SIZE               5
+#endif
+
+#ifndef NWK_ROUTE_ERROR_HOLD_DOWN
+#define NWK_ROUTE_ERROR_HOLD_DOWN                500 // ms
+#endif
+
+#ifndef NWK_TX_BROADCAST_JITTER
+#define NWK_TX_BROADCAST_JITTER                  8 // ms
+#endif
+
+#ifndef NWK_TX_BROADCAST_MIN_JITTER
+#define NWK_TX_BROADCAST_MIN_JITTER              4 // ms, lower bound at high data rates
+#endif
+
+#ifndef NWK_TX_BROADCAST_MAX_JITTER
+#define NWK_TX_BROADCAST_MAX_JITTER              32 // ms
+#endif
+
+#ifndef NWK_TX_BROADCAST_SUPPRESSION_THRESHOLD
+#define NWK_TX_BROADCAST_SUPPRESSION_THRESHOLD   3 // copies heard
+#endif
+
+#ifndef NWK_TX_BROADCAST_SUPPRESSION_RSSI
+#define NWK_TX_BROADCAST_SUPPRESSION_RSSI        (-128) // dBm, weaker copies are not counted
+#endif
+
 #ifndef NWK_ACK_WAIT_TIME
 #define NWK_ACK_WAIT_TIME                        1000 // ms
 #endif
 
+#ifndef NWK_ACK_WAIT_MIN_TIME
+#define NWK_ACK_WAIT_MIN_TIME                    500 // ms, lower bound at high data rates
+#endif
+
 #ifndef NWK_GROUPS_AMOUNT
 #define NWK_GROUPS_AMOUNT                        10
 #endif
 
+#ifndef NWK_GROUPS_MODE
+#define NWK_GROUPS_MODE                          0 // 0 - linear table, 1 - sorted table, 2 - bitmap
+#endif
+
+#ifndef NWK_GROUPS_BITMAP_BASE
+#define NWK_GROUPS_BITMAP_BASE                   0x0000 // first group ID in the bitmap mode
+#endif
+
+#ifndef NWK_MULTICAST_TRICKLE_BUFFERS
+#define NWK_MULTICAST_TRICKLE_BUFFERS            2
+#endif
+
+#ifndef NWK_MULTICAST_TRICKLE_IMIN
+#define NWK_MULTICAST_TRICKLE_IMIN               50 // ms
+#endif
+
+#ifndef NWK_MULTICAST_TRICKLE_IMAX
+#define NWK_MULTICAST_TRICKLE_IMAX               200 // ms
+#endif
+
+#ifndef NWK_MULTICAST_TRICKLE_K
+#define NWK_MULTICAST_TRICKLE_K                  1 // redundancy constant
+#endif
+
+#ifndef NWK_MULTICAST_TRICKLE_EXPIRATIONS
+#define NWK_MULTICAST_TRICKLE_EXPIRATIONS        3 // intervals
+#endif
+
 #ifndef NWK_ROUTE_DISCOVERY_TABLE_SIZE
 #define NWK_ROUTE_DISCOVERY_TABLE_SIZE           5
 #endif
@@ -87,14 +147,145 @@
 #define NWK_ROUTE_DISCOVERY_TIMEOUT              1000 // ms
 #endif
 
+#ifndef NWK_ROUTE_DISCOVERY_RING_MAX_RADIUS
+#define NWK_ROUTE_DISCOVERY_RING_MAX_RADIUS      4 // hops, 0 - disable expanding ring
+#endif
+
+#ifndef NWK_ROUTE_DISCOVERY_RING_HOP_TIMEOUT
+#define NWK_ROUTE_DISCOVERY_RING_HOP_TIMEOUT     50 // ms
+#endif
+
+#ifndef NWK_ROUTE_DISCOVERY_FAILED_TABLE_SIZE
+#define NWK_ROUTE_DISCOVERY_FAILED_TABLE_SIZE    5
+#endif
+
+#ifndef NWK_ROUTE_DISCOVERY_HOLD_DOWN
+#define NWK_ROUTE_DISCOVERY_HOLD_DOWN            2000 // ms
+#endif
+
+#ifndef NWK_ROUTE_DISCOVERY_MAX_HOLD_DOWN
+#define NWK_ROUTE_DISCOVERY_MAX_HOLD_DOWN        30000 // ms
+#endif
+
+#ifndef NWK_ROUTE_DISCOVERY_RATE_WINDOW
+#define NWK_ROUTE_DISCOVERY_RATE_WINDOW          1000 // ms
+#endif
+
+#ifndef NWK_ROUTE_DISCOVERY_MAX_ORIGINATED
+#define NWK_ROUTE_DISCOVERY_MAX_ORIGINATED       4 // discoveries (not ring requests) per rate window
+#endif
+
+#ifndef NWK_ROUTE_DISCOVERY_MAX_FORWARDED
+#define NWK_ROUTE_DISCOVERY_MAX_FORWARDED        10 // per rate window
+#endif
+
+#ifndef NWK_COLLECTION_TRICKLE_IMIN
+#define NWK_COLLECTION_TRICKLE_IMIN              500 // ms
+#endif
+
+#ifndef NWK_COLLECTION_TRICKLE_IMAX
+#define NWK_COLLECTION_TRICKLE_IMAX              64000 // ms
+#endif
+
+#ifndef NWK_COLLECTION_TRICKLE_K
+#define NWK_COLLECTION_TRICKLE_K                 2 // redundancy constant
+#endif
+
+#ifndef NWK_COLLECTION_MAX_COST
+#define NWK_COLLECTION_MAX_COST                  1000
+#endif
+
+#ifndef NWK_COLLECTION_PARENT_SWITCH_THRESHOLD
+#define NWK_COLLECTION_PARENT_SWITCH_THRESHOLD   16 // one perfect hop
+#endif
+
+#ifndef NWK_COLLECTION_PARENT_MAX_FAILURES
+#define NWK_COLLECTION_PARENT_MAX_FAILURES       3
+#endif
+
+#ifndef NWK_SOURCE_ROUTE_TABLE_SIZE
+#define NWK_SOURCE_ROUTE_TABLE_SIZE              20
+#endif
+
+#ifndef NWK_SOURCE_ROUTE_COORDINATOR_ADDR
+#define NWK_SOURCE_ROUTE_COORDINATOR_ADDR        0x0000
+#endif
+
+#ifndef NWK_MAX_HOPS
+#define NWK_MAX_HOPS                             15
+#endif
+
+#ifndef NWK_TX_FRAME_RETRIES
+#define NWK_TX_FRAME_RETRIES                     3 // own unicast frames
+#endif
+
+#ifndef NWK_TX_CSMA_RETRIES
+#define NWK_TX_CSMA_RETRIES                      4 // own unicast frames
+#endif
+
+#ifndef NWK_TX_FORWARD_FRAME_RETRIES
+#define NWK_TX_FORWARD_FRAME_RETRIES             5 // forwarded unicast frames
+#endif
+
+#ifndef NWK_TX_FORWARD_CSMA_RETRIES
+#define NWK_TX_FORWARD_CSMA_RETRIES              5 // forwarded unicast frames
+#endif
+
+#ifndef NWK_TX_BROADCAST_CSMA_RETRIES
+#define NWK_TX_BROADCAST_CSMA_RETRIES            2 // broadcast frames
+#endif
+
+#ifndef NWK_TX_MIN_BE
+#define NWK_TX_MIN_BE                            3
+#endif
+
+#ifndef NWK_TX_MAX_BE
+#define NWK_TX_MAX_BE                            5
+#endif
+
 //#define NWK_ENABLE_ROUTING
 //#define NWK_ENABLE_SECURITY
 //#define NWK_ENABLE_MULTICAST
 //#define NWK_ENABLE_ROUTE_DISCOVERY
 //#define NWK_ENABLE_SECURE_COMMANDS
+//#define NWK_ENABLE_COLLECTION
+//#define NWK_ENABLE_SOURCE_ROUTING
+//#define NWK_ENABLE_HOP_LIMIT
+//#define NWK_ENABLE_OVERHEARING
+//#define NWK_ENABLE_MULTICAST_TRICKLE
+//#define NWK_ENABLE_BROADCAST_SUPPRESSION
+//#define NWK_ENABLE_GROUP_COMMANDS
+//#define NWK_ENABLE_KEY_TABLE
+//#define NWK_ENABLE_FRAME_COUNTER
+//#define NWK_ENABLE_TX_POLICY
+//#define NWK_ENABLE_ROUTE_ERROR_AGGREGATION
+
+#ifndef NWK_SECURITY_CONTEXTS
+#define NWK_SECURITY_CONTEXTS                    2 // frames processed in parallel
+#endif
+
+#ifndef NWK_KEY_TABLE_SIZE
+#define NWK_KEY_TABLE_SIZE                       4 // link and group keys
+#endif
+
+#ifndef NWK_FRAME_COUNTER_TABLE_SIZE
+#define NWK_FRAME_COUNTER_TABLE_SIZE             8 // sources tracked for replay protection
+#endif
+
+#ifndef NWK_FRAME_COUNTER_GAP
+#define NWK_FRAME_COUNTER_GAP                    1024 // frames between checkpoints
+#endif
+
+#ifndef NWK_SECURITY_MODE
+#define NWK_SECURITY_MODE                        0 // 0 - legacy, 1 - CCM*, 2 - encrypt-then-MAC
+#endif
+
+#ifndef NWK_SECURITY_CCM_BURST
+#define NWK_SECURITY_CCM_BURST                   4 // key stream blocks per request
+#endif
 
 #ifndef SYS_SECURITY_MODE
-#define SYS_SECURITY_MODE                        0
+#define SYS_SECURITY_MODE                        0 // 0 - PHY AES, 1 - XTEA, 2 - software AES
 #endif
 
 /*- Sanity checks ----------------------------------------------------------*/
@@ -102,4 +293,64 @@
   #define PHY_ENABLE_AES_MODULE
 #endif
 
+#if SYS_SECURITY_MODE > 2
+  #error Unsupported SYS_SECURITY_MODE
+#endif
+
+#if NWK_TX_BROADCAST_MIN_JITTER < 1
+  #error NWK_TX_BROADCAST_MIN_JITTER must be at least 1
+#endif
+
+#if NWK_ACK_WAIT_MIN_TIME > NWK_ACK_WAIT_TIME
+  #error NWK_ACK_WAIT_MIN_TIME must not exceed NWK_ACK_WAIT_TIME
+#endif
+
+#if NWK_ROUTE_DISCOVERY_RING_MAX_RADIUS > 127
+  #error NWK_ROUTE_DISCOVERY_RING_MAX_RADIUS must not exceed 127
+#endif
+
+#if NWK_SECURITY_MODE > 2
+  #error Unsupported NWK_SECURITY_MODE
+#endif
+
+#if defined(NWK_ENABLE_SECURITY) && (NWK_SECURITY_MODE != 0) && !defined(NWK_ENABLE_FRAME_COUNTER)
+  #error NWK_SECURITY_MODE 1 and 2 require NWK_ENABLE_FRAME_COUNTER
+#endif
+
+#if defined(NWK_ENABLE_TX_POLICY) && (NWK_TX_MIN_BE > NWK_TX_MAX_BE)
+  #error NWK_TX_MIN_BE must not exceed NWK_TX_MAX_BE
+#endif
+
+#if defined(NWK_ENABLE_KEY_TABLE) && !defined(NWK_ENABLE_SECURITY)
+  #error NWK_ENABLE_KEY_TABLE requires NWK_ENABLE_SECURITY
+#endif
+
+#if defined(NWK_ENABLE_FRAME_COUNTER) && !defined(NWK_ENABLE_SECURITY)
+  #error NWK_ENABLE_FRAME_COUNTER requires NWK_ENABLE_SECURITY
+#endif
+
+#if defined(NWK_ENABLE_KEY_TABLE) && (NWK_KEY_TABLE_SIZE > 255)
+  #error NWK_KEY_TABLE_SIZE must not exceed 255
+#endif
+
+#if defined(NWK_ENABLE_COLLECTION) && !defined(NWK_ENABLE_ROUTING)
+  #error NWK_ENABLE_COLLECTION requires NWK_ENABLE_ROUTING
+#endif
+
+#if defined(NWK_ENABLE_GROUP_COMMANDS) && !defined(NWK_ENABLE_MULTICAST)
+  #error NWK_ENABLE_GROUP_COMMANDS requires NWK_ENABLE_MULTICAST
+#endif
+
+#if defined(NWK_ENABLE_MULTICAST_TRICKLE) && !defined(NWK_ENABLE_MULTICAST)
+  #error NWK_ENABLE_MULTICAST_TRICKLE requires NWK_ENABLE_MULTICAST
+#endif
+
+#if defined(NWK_ENABLE_OVERHEARING) && !defined(NWK_ENABLE_ROUTING)
+  #error NWK_ENABLE_OVERHEARING requires NWK_ENABLE_ROUTING
+#endif
+
+#if defined(NWK_ENABLE_SOURCE_ROUTING) && !defined(NWK_ENABLE_ROUTING)
+  #error NWK_ENABLE_SOURCE_ROUTING requires NWK_ENABLE_ROUTING
+#endif
+
 #endif // _SYS_CONFIG_H_
@@ -50,9 +50,19 @@
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
 #include <stdbool.h>
+#include "sysConfig.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#if SYS_SECURITY_MODE == 2
+#define SYS_ENCRYPT_KEY_SIZE     176 // expanded AES-128 key schedule
+#else
+#define SYS_ENCRYPT_KEY_SIZE     16
+#endif
 
 /*- Prototypes -------------------------------------------------------------*/
+void SYS_EncryptPrepareKey(uint8_t *prepared, uint8_t *key);
 void SYS_EncryptReq(uint8_t *text, uint8_t *key);
+void SYS_EncryptBlocksReq(uint8_t *blocks, uint8_t count, uint8_t *key);
 void SYS_EncryptConf(void);
 
 #endif // _SYS_ENCRYPT_H_